@@ -0,0 +1,19 @@
+#ifndef BITPACKING_H
+#define BITPACKING_H
+
+#include <QtGlobal>
+
+// Packs a line of output levels (one byte per pixel, each below
+// 1 << bitsPerPixel) into the bit layout the heads expect: a bit stream, LSB
+// first, pixel i in bits i * bitsPerPixel .. (i + 1) * bitsPerPixel - 1 of the
+// line, counting from bit 0 of byte 0. So with 1 bit per pixel, pixel i is
+// bit i % 8 of byte i / 8; with 2 bits, bits 2 * (i % 4) and up of byte i / 4;
+// with 3 bits, 8 pixels fill 3 bytes. Writes (count * bitsPerPixel + 7) / 8
+// bytes, whole bytes only: the bits after the last pixel are zero and nothing
+// is read back.
+void PackLevels(const uchar* levels, int count, int bitsPerPixel, uchar* packed);
+
+// Bits per pixel of 'levels' output codes: 1, 2 or 3
+int BitsPerPixel(int levels);
+
+#endif // BITPACKING_H
@@ -0,0 +1,105 @@
+#ifndef ERRORDIFFUSION_H
+#define ERRORDIFFUSION_H
+
+#include <QtGlobal>
+#include "InkCurves.h"
+
+// Error diffusion kernels (job setting DiffusionKernel)
+enum DiffusionKernel {
+    DiffusionFloydSteinberg = 0,
+    DiffusionJarvisJudiceNinke = 1,
+    DiffusionStucki = 2,
+    DiffusionSierra3 = 3,
+    DiffusionSierra2 = 4,
+    DiffusionSierraLite = 5,
+    DiffusionVariable = 6,              // Ostromoukhov-style weights picked by the input tone
+    DiffusionVariableModulated = 7      // The same with tone-dependent threshold modulation
+};
+
+// Error diffusion handles the ink planes in groups of four. The errors of a
+// group are stored interleaved, 4 terms per pixel, so the four independent
+// recurrences advance together in one sequential pass over the row.
+const int kDiffusionLanes = 4;
+
+// Bytes of one error term: a float, or a qint32 for the fixed-point kernels
+const int kDiffusionTermBytes = 4;
+
+// Fixed-point kernels keep the errors in 1/32 of an ink level and the weights
+// in 1/4096. A share is rounded to the nearest unit and the first tap takes
+// what the others leave, so every error is passed on in full. Their tone
+// follows the float kernels: on flat tints the mean ink of a plane stays
+// within 0.1 (on the 0-255 ink scale) of the float kernel's.
+const int kFixedErrorBits = 5;
+const int kFixedWeightBits = 12;
+
+// Guard pixels on both sides of an error line, enough for the widest kernel,
+// so the edges need no branches (the guards are never read)
+const int kDiffusionGuard = 2;
+
+// The ink planes of one diffusion group; unused lanes have no plane
+struct DiffusionGroup {
+    const InkPlane* planes[kDiffusionLanes];
+    int lanes;
+    int first;          // Index of the first plane, so each plane gets its own noise
+};
+
+// Diffuses pixels x0 .. x1 - 1 of one row for a group of planes, left to right
+// or (serpentine) right to left. 'errorLines' point at pixel 0 of the error
+// lines of the current row and the rows below it (as many as the kernel
+// reaches); the lines hold floats or, for the fixed-point kernels, qint32s,
+// and start out zeroed. Pixel 0 of the row is at 'originX', 'y' in the image;
+// kernels that add noise key it to that position, so it does not depend on
+// how the image is split up. The output levels are written to 'levels', one
+// line per lane 'levelStride' bytes apart, pixel x at index x - x0, ready for
+// PackLevels.
+typedef void (*DiffusionBlockFunction)(const uchar* inputRow, const DiffusionGroup& group,
+                                       void* const* errorLines, int originX, int y, int x0, int x1,
+                                       uchar* levels, int levelStride);
+
+// A kernel with its taps compiled in (the variable kernels look up their
+// weights for every pixel). Pixels are quantized through the
+// nearest-code and drop tables of their plane, so one kernel serves every
+// level count and drop spacing.
+struct DiffusionKernelInfo {
+    int rows;                       // Error lines written: the current row and those below
+    int reach;                      // Pixels reached to the left and right
+    DiffusionBlockFunction forward;
+    DiffusionBlockFunction reverse;
+};
+
+// Weights of the variable kernels at key tones (0 = no ink) and the threshold
+// modulation in 1/128 of a drop step. Tones in between are interpolated
+// linearly and tones past mid-grey mirror those below it; the weights of
+// every key sum to 1.
+struct VariableDiffusionKey {
+    int tone;
+    float right;
+    float downLeft;
+    float down;
+    float modulation;
+};
+
+const VariableDiffusionKey kVariableDiffusionKeys[] = {
+    {0, 0.722f, 0.000f, 0.278f, 0.0f},
+    {11, 0.535f, 0.239f, 0.226f, 0.0f},
+    {22, 0.500f, 0.333f, 0.167f, 8.0f},
+    {42, 0.400f, 0.200f, 0.400f, 24.0f},
+    {84, 0.450f, 0.250f, 0.300f, 40.0f},
+    {127, 0.467f, 0.200f, 0.333f, 48.0f}
+};
+
+// Row of the variable kernels' per-tone table for input tone 'tone' (0-255):
+// the right, down-left and down weights, normalized to sum to 1, and the
+// modulation in drop steps. The fixed-point row has the weights in 1/4096 and
+// the modulation in 1/128 step, each rounded from the float row.
+const float* VariableDiffusionWeights(int tone);
+const qint32* VariableDiffusionFixedWeights(int tone);
+
+// Kernel for a job, picked once from the table of all kernels. Each entry is a
+// straight-line loop with the weights and the scan direction built in.
+// 'fixedPoint' picks the integer variant: it quantizes with vector compares
+// instead of per-lane table lookups and spreads the errors without any float
+// conversion.
+DiffusionKernelInfo SelectDiffusionKernel(int kernel, bool fixedPoint);
+
+#endif // ERRORDIFFUSION_H
@@ -0,0 +1,68 @@
+#ifndef INKCURVES_H
+#define INKCURVES_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "JobSettings.h"
+
+// Most output codes a plane can have (3 bits per pixel)
+const int kMaxOutputLevels = 8;
+
+// One output plane of the dithered image. Each plane reads one channel of the
+// interleaved CMYK buffer through its own 256-entry table, so splitting a base
+// ink into dark and light variants is a single lookup in the dither input stage.
+// Output code i prints drops[i] of ink, on the same 0-255 scale as the table;
+// variable-drop heads have unevenly spaced drops, others evenly spaced ones.
+struct InkPlane {
+    QString name;       // Ink name as used in the job settings (C, Lc, K, LLk...)
+    int source;         // Source channel in the CMYK buffer (0=C, 1=M, 2=Y, 3=K)
+    uchar lut[256];     // Input level -> ink amount
+    int levels;                         // Output codes (2..kMaxOutputLevels)
+    float drops[kMaxOutputLevels];      // Ink amount of each code, rising from 0
+    uchar nearest[256];                 // Ink amount -> code of the closest drop
+    uchar tones[256];                   // Ink amount -> position between the drops around it (0-255)
+};
+
+// Build the output planes of a job: C, M, Y, K first, followed by the enabled
+// light inks in Lc, Lm, Lk, LLk order. A plane has the drop densities the job
+// gives it, or evenly spaced output codes: 'nLevel', or as many as the plane
+// with the most densities when that is more (see BuildLevelTables). The
+// linearization and ink restriction curves of the job's calibration file for
+// the resulting level count are folded into the plane tables, so they cost
+// nothing in the dither loops.
+QVector<InkPlane> BuildInkPlanes(const JobSettings& settings, int nLevel);
+
+// Level count of a job: the most output codes of any of its planes
+int OutputLevels(const QVector<InkPlane>& planes);
+
+// Set the output codes of every plane from its "d0,d1,..." drop density
+// setting in 'drops' (same order as 'planes', empty for none). Planes without
+// a valid setting get evenly spaced codes, as many as the job's level count:
+// 'nLevel', or more when a setting has more codes. Returns that level count.
+int BuildLevelTables(QVector<InkPlane>& planes, int nLevel, const QStringList& drops);
+
+// Set the output codes of a plane: 'levels' evenly spaced drops, or the drop
+// densities of a "d0,d1,..." setting (0-255, rising, d0 = 0, at most
+// kMaxOutputLevels). Fills the nearest-code and tone tables; returns false and
+// keeps the even spacing when the setting is invalid.
+bool BuildLevelTable(InkPlane& plane, int levels, const QString& drops);
+
+// Fill a 256-entry split curve: zero up to 'start', rising to full ink at 'peak',
+// then tapering to 'endLevel' at input 255.
+void BuildSplitCurve(uchar* lut, int start, int peak, int endLevel);
+
+// Fill a 256-entry curve from "in:out,in:out,..." control points (0-255),
+// interpolating linearly. Returns false and leaves an identity curve on errors.
+bool BuildPointCurve(uchar* lut, const QString& points);
+
+// Fill a 256-entry RGB tone curve: the "in:out" control points (identity when
+// empty), then brightness (-100..100, a shift of up to half the range) and
+// contrast (-100..100, a slope around mid-grey from 0 to 100x).
+void BuildToneCurve(uchar* lut, const QString& points, int brightness, int contrast);
+
+// Compose the curves of a calibration file into the plane tables. Curves are
+// matched by ink name; a <Curves levels="n"> block only applies to n-level output.
+bool ApplyCalibration(QVector<InkPlane>& planes, const QString& calibrationFile, int nLevel);
+
+#endif // INKCURVES_H
@@ -5,14 +5,71 @@
 #include <QByteArray>
 #include <QString>
 #include "ProcessStruct.h"
+#include "Resampler.h"
+
+// Decode the job image no larger than the planned output needs. Decoders that
+// scale natively (JPEG decodes 1/2, 1/4 or 1/8 in the DCT domain) are asked for
+// the smallest such scale that still covers 'outputSize'; other formats decode
+// at full size. The dots per meter follow the decode scale, so the physical
+// size of the image is unchanged.
+QImage loadJobImage(const QString &path, const QSize &outputSize);
+
+// Decode an image scaled to fit 'boundingSize' with its aspect ratio, for
+// previews. 'fullSize' receives the pixel size of the file.
+QImage loadPreviewImage(const QString &path, const QSize &boundingSize, QSize *fullSize = nullptr);
 
 QByteArray convertRGBtoLAB(const QImage &image,  TagJobInfoRecord &jobInfo);
 QByteArray convertLABtoCMYK(const QByteArray &labDataBuf,  TagJobInfoRecord &jobInfo);
 QByteArray resizeCMYKData(const QByteArray &cmykDataBuf,  TagJobInfoRecord &jobInfo);
-QByteArray floydSteinbergDitherFloat(const QByteArray &cmykDataBuf, TagJobInfoRecord &jobInfo);
+// Determinism: the .prn file of a job depends on its image and settings only,
+// never on the core count or the scheduling. Every parallel stage cuts its
+// work into fixed rows, bands (kParallelBandRows) and strips; each output byte
+// is computed by one task with the same float operations in the same order,
+// with no reductions across tasks; the SIMD and scalar paths give the same
+// bytes; and any noise must be keyed by absolute pixel coordinates, never by
+// thread or call order. The build turns off floating-point contraction so the
+// compiler cannot fuse operations differently between paths.
+//
+// The dither stages return the .prn file as it is written: the header, then
+// every row as one line per plane in K, C, M, Y, light-ink order, each padded
+// to a multiple of 4 bytes (the header's nBytesPerLine).
+
+// Error diffusion with the job's kernel (Floyd-Steinberg, Jarvis-Judice-Ninke,
+// Stucki, Sierra-3/2/Lite), optionally with a serpentine scan
+QByteArray errorDiffusionDither(const QByteArray &cmykDataBuf, TagJobInfoRecord &jobInfo);
+QByteArray errorDiffusionDither(RowResampler &resampler, TagJobInfoRecord &jobInfo);
 //QByteArray floydSteinbergDitherInt(const QByteArray &cmykDataBuf, const TagJobInfoRecord &jobInfo);
 //QByteArray floydSteinbergDitherFloatMP(const QByteArray &cmykDataBuf, const TagJobInfoRecord &jobInfo);
 QByteArray orderedDither(const QByteArray &cmykDataBuf,  TagJobInfoRecord &jobInfo);
+QByteArray orderedDither(RowResampler &resampler, TagJobInfoRecord &jobInfo);
+
+// Row-by-row resize of the CMYK image to the output resolution. The dither
+// stages pull rows from it, so the full-resolution image is never stored.
+RowResampler createCMYKResampler(const QByteArray &cmykDataBuf, const TagJobInfoRecord &jobInfo);
+// Order of the colour conversion and the resize. Converting is by far the most
+// expensive per-pixel stage, so it should run at whichever resolution is
+// smaller; the resize costs about the same on 4-byte RGB or CMYK pixels.
+enum StageOrder {
+    ConvertThenResize,      // Convert at source resolution, resize in CMYK
+    ResizeThenConvert       // Resize the RGB image, convert at output resolution
+};
+
+struct StagePlan {
+    StageOrder order;
+    double convertThenResizeCost;   // Estimated work of each order, in pixel-operation units
+    double resizeThenConvertCost;
+    QString summary;                // One line for the job log
+};
+
+// Pick the cheaper stage order from the scale factors, the channel counts and
+// whether the conversions go through ICC transforms or the formula fallback
+StagePlan planStageOrder(const TagJobInfoRecord &jobInfo);
+
+// Resize the RGB image to the output size (ResizeThenConvert). The job's width
+// and height follow the image and the CMYK resize becomes a no-op.
+QImage resizeRGBImage(const QImage &image, TagJobInfoRecord &jobInfo);
+
+// Write the output of a dither stage to a .prn file, in one contiguous write
 int CreatePrnFile(const QString &prnFilePath, const QByteArray &outDataBuf, const TagJobInfoRecord &jobInfo);
 
 #endif // RGBTOLABCONVERTER_H
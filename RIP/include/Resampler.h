@@ -0,0 +1,169 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QtGlobal>
+
+// Resampling filters for resizing the CMYK image (job setting ResampleFilter)
+enum ResampleFilter {
+    ResampleBilinear = 0,
+    ResampleMitchell = 1,
+    ResampleLanczos3 = 2,
+    ResampleReplicate = 3       // Pixel replication / nearest sample, for fast drafts
+};
+
+// Reduced output:input ratio of one axis (dst:src = numerator:denominator)
+struct ResampleRatio {
+    int numerator;
+    int denominator;
+};
+
+// Filter taps of every output sample along one axis, computed once per resize.
+// Output sample i reads 'taps' consecutive source samples starting at start[i]
+// with weights[i * taps + k]; the weights of each sample sum to one. When
+// downscaling the kernel is stretched by the ratio so every source sample
+// contributes, which removes the aliasing of plain point sampling.
+struct ResampleCoefficients {
+    int taps;                   // Taps per output sample
+    QVector<int> start;         // First source index of each output sample
+    QVector<float> weights;     // Tap weights, 'taps' per output sample
+};
+
+// Coefficient tables of a 2D resize: horizontal (x) and vertical (y) pass
+struct ResamplePlan {
+    int srcWidth;
+    int srcHeight;
+    int dstWidth;
+    int dstHeight;
+    ResampleCoefficients x;
+    ResampleCoefficients y;
+};
+
+// Fixed-point bilinear taps along one axis: both source indices and the 8-bit
+// weight of the second one. Positions are computed in integers, so the tables
+// (and the output) are identical on every machine.
+struct BilinearTable {
+    QVector<int> index0;        // First source index
+    QVector<int> index1;        // Second source index
+    QVector<int> fraction;      // Weight of index1 in 1/256 (0..255)
+    QVector<quint32> weights;   // (fraction << 16) | (256 - fraction), for pmaddwd
+};
+
+ResampleCoefficients BuildResampleCoefficients(int srcSize, int dstSize, ResampleFilter filter);
+ResamplePlan BuildResamplePlan(int srcWidth, int srcHeight, int dstWidth, int dstHeight, ResampleFilter filter);
+
+// Horizontal pass of one interleaved CMYK row into 4 floats per output pixel
+void ResampleRowHorizontal(const uchar* src, float* dst, const ResampleCoefficients& coeffs, int dstWidth);
+
+BilinearTable BuildBilinearTable(int srcSize, int dstSize);
+
+// Ratio of one axis, and whether it is simple enough for phase tables
+ResampleRatio ReduceResampleRatio(int srcSize, int dstSize);
+bool IsSimpleRatio(const ResampleRatio& ratio);
+
+// Nearest source index of every output sample along one axis. For a simple
+// ratio the indices repeat with period 'numerator', so only one period is
+// computed: index(i) = (i / numerator) * denominator + phase[i % numerator].
+QVector<int> BuildReplicateTable(int srcSize, int dstSize);
+
+// Fixed-point bilinear rows. The horizontal pass keeps 8 fractional bits per
+// channel in a 32-bit sum, the vertical blend rounds the 16.16 result:
+//   h = p0 * (256 - fx) + p1 * fx
+//   v = (h0 * (256 - fy) + h1 * fy + 32768) >> 16
+// The AVX2 kernels compute exactly the same integers; the scalar versions are
+// the reference they are checked against.
+void BilinearRowFixedScalar(const uchar* src, qint32* dst, const BilinearTable& table, int x0, int x1);
+void BilinearBlendFixedScalar(const qint32* row0, const qint32* row1, int fraction, uchar* dst, int count);
+bool BilinearAvx2Supported();
+
+// Resizes an interleaved CMYK image one output row at a time. Only the source
+// rows the current output row needs are kept, in a small ring (2 rows for
+// bilinear, 4-6 for Mitchell/Lanczos upscales), so a consumer pulling rows in
+// order never needs the full-resolution image in memory.
+//
+//   bilinear upscale    fixed-point kernels (AVX2 when available), bit-exact
+//   bilinear downscale  exact area averaging, each source row reduced once
+//   replicate           nearest source pixel; repeated rows are not recomputed
+//   other filters       separable float passes with precomputed coefficients
+//
+// Copies share the tables and the source image, so one resampler can be cloned
+// per band or thread; every clone keeps its own ring.
+class RowResampler {
+public:
+    RowResampler(const QByteArray& cmykDataBuf, int width, int height, int newWidth, int newHeight, ResampleFilter filter);
+
+    bool isValid() const { return m_mode != Invalid; }
+    int width() const { return m_newWidth; }
+    int height() const { return m_newHeight; }
+
+    // Same size in and out: row() points straight into the source image
+    bool isPassThrough() const { return m_mode == Copy; }
+
+    // Pull API: the next output row, or nullptr after the last one
+    const uchar* nextRow();
+
+    // Output row y (width() * 4 bytes), valid until the next call. Rows pulled
+    // in increasing order reuse the cached source rows.
+    const uchar* row(int y);
+
+    // Same as nextRow()/row(), but the row is written straight into 'dst'
+    // (width() * 4 bytes), e.g. a cache-resident scratch line of the consumer
+    bool readNextRow(uchar* dst);
+    bool readRow(int y, uchar* dst);
+
+    // Rewind the pull API to output row y
+    void seek(int y) { m_nextY = y; }
+
+    // Use the AVX2 kernels when the CPU has them (default). The output is the
+    // same either way; switching them off gives the scalar reference.
+    void setSimdEnabled(bool enabled) { m_simd = enabled && BilinearAvx2Supported(); }
+
+private:
+    enum Mode { Invalid, Copy, Replicate, BilinearFixed, Area, Separable };
+
+    const uchar* sourceRow(int y) const { return m_src + static_cast<qsizetype>(y) * m_width * 4; }
+    void allocateBuffers();
+    void resampleRow(int y, uchar* dst);
+    void bilinearRow(int y, uchar* dst);
+    void areaRow(int y, uchar* dst);
+    void separableRow(int y, uchar* dst);
+
+    QByteArray m_source;        // Keeps the source image alive (implicitly shared)
+    const uchar* m_src;
+    int m_width;
+    int m_height;
+    int m_newWidth;
+    int m_newHeight;
+    Mode m_mode;
+    bool m_simd;
+    int m_nextY;
+    int m_lineRow;              // Source row held in m_line (replicate)
+
+    // Axis tables, shared between copies
+    ResamplePlan m_plan;
+    BilinearTable m_xBilinear;
+    BilinearTable m_yBilinear;
+    QVector<int> m_xReplicate;
+    QVector<int> m_yReplicate;
+
+    // Working buffers of this copy, allocated on first use
+    QVector<float> m_floatRing;
+    QVector<qint32> m_fixedRing;
+    QVector<int> m_ringRow;
+    QVector<const float*> m_rowPtrs;
+    QVector<qint64> m_prefix;
+    QVector<qint64> m_rowSums;
+    QVector<qint64> m_columnSums;
+    QVector<uchar> m_line;
+};
+
+// Rows of one band of a parallel row stage. Bands are cut by row count alone,
+// never by core count, so the work items of a job are the same on every machine.
+const int kParallelBandRows = 32;
+
+// Resize a whole interleaved CMYK image, banded over all cores. Any 4-channel
+// 8-bit interleaved buffer works the same way, e.g. ARGB32 image data.
+QByteArray ResampleCMYK(const QByteArray& cmykDataBuf, int width, int height, int newWidth, int newHeight, ResampleFilter filter);
+
+#endif // RESAMPLER_H
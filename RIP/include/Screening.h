@@ -0,0 +1,65 @@
+#ifndef SCREENING_H
+#define SCREENING_H
+
+#include <QVector>
+#include <QtGlobal>
+
+// Screens of the ordered dither, picked by the Dithering setting (dithering / 3;
+// dithering % 3 is the level count)
+enum ScreenMethod {
+    ScreenBayer = 1,            // 8x8 Bayer matrix
+    ScreenBlueNoise = 2,        // 256x256 void-and-cluster blue noise (FM)
+    ScreenAM = 3                // Clustered dots at the classic angles (AM)
+};
+
+// AM screen angles of the C, M, Y and K channels, in degrees. Light inks use
+// the angle of their base ink at a phase offset.
+const float kAmScreenAngles[4] = { 15.0f, 75.0f, 0.0f, 45.0f };
+
+// Threshold tile of an ordered screen, repeated over the image. Thresholds are
+// 0..254 and spread evenly over that range, so a tone t in 1/255 covers about
+// t of the tile: a pixel prints when its tone is above the threshold.
+struct ThresholdTile {
+    int width;
+    int height;
+    QVector<uchar> thresholds;  // Row by row, width * height
+};
+
+// Tile of a screen method; generated once and kept for the next jobs
+ThresholdTile ScreenTile(int method);
+
+ThresholdTile BayerTile();
+
+// Blue-noise tile of size x size. Generating it takes a moment, so it is kept
+// in memory and cached on disk.
+ThresholdTile BlueNoiseTile(int size);
+
+// AM supercell of 'lpi' lines per inch at 'angle' degrees for a 'resolution'
+// dpi device. The dot lattice is fitted to a rational tangent so the tile
+// repeats exactly; angle and frequency are matched as closely as a tile of
+// at most 512x512 allows. Tiles are kept for the next jobs.
+ThresholdTile AmScreenTile(float angle, float lpi, float resolution);
+
+// Void-and-cluster ranks (0 .. size * size - 1) of a size x size torus: every
+// prefix of the ranks is an evenly spread point set without low frequencies
+QVector<quint16> GenerateBlueNoiseRanks(int size);
+
+// Screens one row of a plane and packs it with PackLevels. A pixel gets level
+// base + 1 where its remainder is above the threshold and level base
+// otherwise. The three inputs hold 'count' samples, a multiple of 32;
+// 'packed' receives count * bitsPerPixel / 8 bytes.
+void ScreenRow(const uchar* base, const uchar* remainder, const uchar* thresholds,
+               int count, int bitsPerPixel, uchar* packed);
+
+// Tile origin of ink plane 'plane'. The planes read the tile at offsets
+// spread over it, so the inks do not print dot on dot.
+void ScreenOffset(const ThresholdTile& tile, int plane, int& offsetX, int& offsetY);
+
+// Screen of ink plane 'plane', which reads CMYK channel 'source': the FM tile
+// at the plane's offset, or the AM tile at the angle of its channel. Light
+// inks (planes 4 and up) read the AM tile of their base ink half a cell off,
+// so they do not print dot on dot with it.
+void PlaneScreen(int method, int plane, int source, float lpi, float resolution,
+                 ThresholdTile& tile, int& offsetX, int& offsetY);
+
+#endif // SCREENING_H
@@ -0,0 +1,89 @@
+#include "BitPacking.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RIP_SSE_PACKING 1
+#endif
+
+#ifdef RIP_SSE_PACKING
+// Packs the 1-bit levels of 32 pixels into 4 bytes. The level is the lowest
+// bit of each byte; movemask collects it from the sign bit, pixel i to bit i.
+static inline void packBits(__m128i low, __m128i high, uchar* packed) {
+    const quint32 bits = static_cast<quint32>(_mm_movemask_epi8(_mm_slli_epi16(low, 7)))
+                       | static_cast<quint32>(_mm_movemask_epi8(_mm_slli_epi16(high, 7))) << 16;
+    const uchar bytes[4] = { static_cast<uchar>(bits), static_cast<uchar>(bits >> 8),
+                             static_cast<uchar>(bits >> 16), static_cast<uchar>(bits >> 24) };
+    memcpy(packed, bytes, 4);
+}
+
+// Packs the 2-bit levels of 16 pixels into the low byte of each 32-bit lane
+static inline __m128i packLevelQuads(__m128i levels) {
+    const __m128i pairs = _mm_or_si128(_mm_and_si128(levels, _mm_set1_epi16(0x00FF)),
+                                       _mm_slli_epi16(_mm_srli_epi16(levels, 8), 2));
+    return _mm_or_si128(_mm_and_si128(pairs, _mm_set1_epi32(0xFFFF)),
+                        _mm_slli_epi32(_mm_srli_epi32(pairs, 16), 4));
+}
+
+// Packs the 2-bit levels of 32 pixels into 8 bytes
+static inline void packQuads(__m128i low, __m128i high, uchar* packed) {
+    const __m128i quads = _mm_packs_epi32(packLevelQuads(low), packLevelQuads(high));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(packed), _mm_packus_epi16(quads, quads));
+}
+
+// Packs the 3-bit levels of 16 pixels into 24 bits at the bottom of each
+// 64-bit lane, 8 pixels per lane
+static inline void packTriples(__m128i levels, uchar* packed) {
+    const __m128i pairs = _mm_or_si128(_mm_and_si128(levels, _mm_set1_epi16(0x00FF)),
+                                       _mm_slli_epi16(_mm_srli_epi16(levels, 8), 3));
+    const __m128i quads = _mm_or_si128(_mm_and_si128(pairs, _mm_set1_epi32(0xFFFF)),
+                                       _mm_slli_epi32(_mm_srli_epi32(pairs, 16), 6));
+    const __m128i octets = _mm_or_si128(_mm_and_si128(quads, _mm_set_epi32(0, -1, 0, -1)),
+                                        _mm_slli_epi64(_mm_srli_epi64(quads, 32), 12));
+    uchar bytes[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes), octets);
+    memcpy(packed, bytes, 3);
+    memcpy(packed + 3, bytes + 8, 3);
+}
+#endif
+
+void PackLevels(const uchar* levels, int count, int bitsPerPixel, uchar* packed) {
+    int x = 0;
+#ifdef RIP_SSE_PACKING
+    // 32 pixels at a time
+    for (; x + 32 <= count; x += 32) {
+        const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(levels + x));
+        const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(levels + x + 16));
+        if (bitsPerPixel == 1) {
+            packBits(low, high, packed + x / 8);
+        } else if (bitsPerPixel == 2) {
+            packQuads(low, high, packed + x / 4);
+        } else {
+            packTriples(low, packed + x * 3 / 8);
+            packTriples(high, packed + x * 3 / 8 + 6);
+        }
+    }
+#endif
+
+    // Remaining pixels through a bit accumulator; x starts on a byte boundary
+    // and the last byte may be partial
+    uchar* output = packed + x * bitsPerPixel / 8;
+    quint32 bits = 0;
+    int bitCount = 0;
+    for (; x < count; ++x) {
+        bits |= static_cast<quint32>(levels[x]) << bitCount;
+        bitCount += bitsPerPixel;
+        if (bitCount >= 8) {
+            *output++ = static_cast<uchar>(bits);
+            bits >>= 8;
+            bitCount -= 8;
+        }
+    }
+    if (bitCount > 0) {
+        *output = static_cast<uchar>(bits);
+    }
+}
+
+int BitsPerPixel(int levels) {
+    return levels <= 2 ? 1 : levels <= 4 ? 2 : 3;
+}
@@ -0,0 +1,661 @@
+#include "ErrorDiffusion.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <iterator>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RIP_SSE_DIFFUSION 1
+#endif
+
+// One kernel weight: the share of the error that goes dx pixels ahead (in scan
+// direction) and dy rows down
+struct DiffusionTap {
+    int dx;
+    int dy;
+    float weight;
+};
+
+struct FloydSteinbergKernel {
+    static constexpr int rows = 2;
+    static constexpr int reach = 1;
+    static constexpr DiffusionTap taps[] = {
+        {1, 0, 7.0f / 16},
+        {-1, 1, 3.0f / 16}, {0, 1, 5.0f / 16}, {1, 1, 1.0f / 16}
+    };
+};
+
+struct JarvisJudiceNinkeKernel {
+    static constexpr int rows = 3;
+    static constexpr int reach = 2;
+    static constexpr DiffusionTap taps[] = {
+        {1, 0, 7.0f / 48}, {2, 0, 5.0f / 48},
+        {-2, 1, 3.0f / 48}, {-1, 1, 5.0f / 48}, {0, 1, 7.0f / 48}, {1, 1, 5.0f / 48}, {2, 1, 3.0f / 48},
+        {-2, 2, 1.0f / 48}, {-1, 2, 3.0f / 48}, {0, 2, 5.0f / 48}, {1, 2, 3.0f / 48}, {2, 2, 1.0f / 48}
+    };
+};
+
+struct StuckiKernel {
+    static constexpr int rows = 3;
+    static constexpr int reach = 2;
+    static constexpr DiffusionTap taps[] = {
+        {1, 0, 8.0f / 42}, {2, 0, 4.0f / 42},
+        {-2, 1, 2.0f / 42}, {-1, 1, 4.0f / 42}, {0, 1, 8.0f / 42}, {1, 1, 4.0f / 42}, {2, 1, 2.0f / 42},
+        {-2, 2, 1.0f / 42}, {-1, 2, 2.0f / 42}, {0, 2, 4.0f / 42}, {1, 2, 2.0f / 42}, {2, 2, 1.0f / 42}
+    };
+};
+
+struct Sierra3Kernel {
+    static constexpr int rows = 3;
+    static constexpr int reach = 2;
+    static constexpr DiffusionTap taps[] = {
+        {1, 0, 5.0f / 32}, {2, 0, 3.0f / 32},
+        {-2, 1, 2.0f / 32}, {-1, 1, 4.0f / 32}, {0, 1, 5.0f / 32}, {1, 1, 4.0f / 32}, {2, 1, 2.0f / 32},
+        {-1, 2, 2.0f / 32}, {0, 2, 3.0f / 32}, {1, 2, 2.0f / 32}
+    };
+};
+
+struct Sierra2Kernel {
+    static constexpr int rows = 2;
+    static constexpr int reach = 2;
+    static constexpr DiffusionTap taps[] = {
+        {1, 0, 4.0f / 16}, {2, 0, 3.0f / 16},
+        {-2, 1, 1.0f / 16}, {-1, 1, 2.0f / 16}, {0, 1, 3.0f / 16}, {1, 1, 2.0f / 16}, {2, 1, 1.0f / 16}
+    };
+};
+
+struct SierraLiteKernel {
+    static constexpr int rows = 2;
+    static constexpr int reach = 1;
+    static constexpr DiffusionTap taps[] = {
+        {1, 0, 2.0f / 4},
+        {-1, 1, 1.0f / 4}, {0, 1, 1.0f / 4}
+    };
+};
+
+#ifdef RIP_SSE_DIFFUSION
+// std::round (halves away from zero) for 4 floats with SSE2 only: truncate,
+// then step one away from zero when the dropped fraction is at least a half
+static inline __m128 roundHalfAway(__m128 value) {
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(value));
+    __m128 fraction = _mm_andnot_ps(signMask, _mm_sub_ps(value, truncated));
+    __m128 step = _mm_or_ps(_mm_and_ps(value, signMask), _mm_set1_ps(1.0f));
+    return _mm_add_ps(truncated, _mm_and_ps(_mm_cmpge_ps(fraction, _mm_set1_ps(0.5f)), step));
+}
+
+// Adds one weighted share of the error; the tap is a compile-time constant
+template <class Kernel, bool Reverse, std::size_t Tap>
+static inline void addTap(__m128 error, float* const* lines, int x) {
+    constexpr DiffusionTap tap = Kernel::taps[Tap];
+    float* target = lines[tap.dy] + (x + (Reverse ? -tap.dx : tap.dx)) * kDiffusionLanes;
+    _mm_storeu_ps(target, _mm_add_ps(_mm_loadu_ps(target), _mm_mul_ps(error, _mm_set1_ps(tap.weight))));
+}
+
+template <class Kernel, bool Reverse, std::size_t... Tap>
+static inline void spreadError(__m128 error, float* const* lines, int x, std::index_sequence<Tap...>) {
+    (addTap<Kernel, Reverse, Tap>(error, lines, x), ...);
+}
+#else
+template <class Kernel, bool Reverse, std::size_t Tap>
+static inline void addTap(const float* error, float* const* lines, int x) {
+    constexpr DiffusionTap tap = Kernel::taps[Tap];
+    float* target = lines[tap.dy] + (x + (Reverse ? -tap.dx : tap.dx)) * kDiffusionLanes;
+    for (int lane = 0; lane < kDiffusionLanes; ++lane) {
+        target[lane] += error[lane] * tap.weight;
+    }
+}
+
+template <class Kernel, bool Reverse, std::size_t... Tap>
+static inline void spreadError(const float* error, float* const* lines, int x, std::index_sequence<Tap...>) {
+    (addTap<Kernel, Reverse, Tap>(error, lines, x), ...);
+}
+#endif
+
+// Quantizes a pixel through the tables of its plane: the nearest output code
+// of the ink amount (clamped and rounded half away from zero, which for evenly
+// spaced drops is exactly round(value / step)) and the ink that code prints
+static inline float quantize(const InkPlane* plane, int amount, uchar& code) {
+    code = plane->nearest[amount];
+    return plane->drops[code];
+}
+
+// The four lanes of every pixel go through the same arithmetic in the same
+// order as the scalar loop, so both paths give identical output.
+template <class Kernel, bool Reverse>
+static void diffuseBlock(const uchar* inputRow, const DiffusionGroup& group,
+                         void* const* errorLines, int, int, int x0, int x1,
+                         uchar* levels, int levelStride) {
+    constexpr auto taps = std::make_index_sequence<std::size(Kernel::taps)>();
+    float* lines[Kernel::rows];
+    for (int k = 0; k < Kernel::rows; ++k) {
+        lines[k] = static_cast<float*>(errorLines[k]);
+    }
+    float* currentErrors = lines[0];
+
+#ifdef RIP_SSE_DIFFUSION
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 full = _mm_set1_ps(255.0f);
+#endif
+
+    for (int i = 0; i < x1 - x0; ++i) {
+        const int x = Reverse ? x1 - 1 - i : x0 + i;
+        const uchar* pixel = inputRow + x * 4;
+        float input[kDiffusionLanes] = {};
+        for (int lane = 0; lane < group.lanes; ++lane) {
+            input[lane] = group.planes[lane]->lut[pixel[group.planes[lane]->source]];
+        }
+
+#ifdef RIP_SSE_DIFFUSION
+        // Ink amounts of the four planes, then their codes from the tables
+        __m128 oldPixel = _mm_add_ps(_mm_loadu_ps(input), _mm_loadu_ps(currentErrors + x * kDiffusionLanes));
+        alignas(16) qint32 amounts[kDiffusionLanes];
+        _mm_store_si128(reinterpret_cast<__m128i*>(amounts),
+                        _mm_cvttps_epi32(roundHalfAway(_mm_min_ps(_mm_max_ps(oldPixel, zero), full))));
+        float newPixel[kDiffusionLanes] = {};
+        for (int lane = 0; lane < group.lanes; ++lane) {
+            uchar code;
+            newPixel[lane] = quantize(group.planes[lane], amounts[lane], code);
+            levels[lane * levelStride + x - x0] = code;
+        }
+
+        // Distribute the errors to neighboring pixels (past the edges into the
+        // guards; after the last row into unused lines)
+        spreadError<Kernel, Reverse>(_mm_sub_ps(oldPixel, _mm_loadu_ps(newPixel)), lines, x, taps);
+#else
+        float error[kDiffusionLanes] = {};
+        for (int lane = 0; lane < group.lanes; ++lane) {
+            float oldPixel = input[lane] + currentErrors[x * kDiffusionLanes + lane];
+
+            // Quantize the pixel
+            uchar code;
+            const int amount = static_cast<int>(std::round(std::clamp(oldPixel, 0.0f, 255.0f)));
+            error[lane] = oldPixel - quantize(group.planes[lane], amount, code);
+            levels[lane * levelStride + x - x0] = code;
+        }
+
+        // Distribute the errors to neighboring pixels
+        spreadError<Kernel, Reverse>(error, lines, x, taps);
+#endif
+    }
+}
+
+// Fixed-point variant. Errors are qint32 in 1/32 ink level; the error of a
+// pixel is saturated to 16 bits (over 1000 ink levels either way) so a share
+// is one 16 x 16 bit multiply, rounded half up to whole units. The first tap
+// gets the error minus the other shares, so nothing is lost to rounding.
+// Both paths run the same integer arithmetic and give identical output.
+
+// Weight of a tap in 1/4096
+template <class Kernel, std::size_t Tap>
+static constexpr qint32 fixedWeight() {
+    return static_cast<qint32>(Kernel::taps[Tap].weight * (1 << kFixedWeightBits) + 0.5f);
+}
+
+// Quantization steps of a group: a value steps from code i to code i + 1 once
+// twice the value is above thresholds[i] (twice the midpoint of their drops,
+// less one, so ties go up as in the nearest-code table), and its drop grows
+// by deltas[i]. Lanes with fewer codes never take the extra steps. Returns
+// the number of steps.
+static int fixedSteps(const DiffusionGroup& group, qint32 (*thresholds)[kDiffusionLanes],
+                      qint32 (*deltas)[kDiffusionLanes]) {
+    int steps = 0;
+    for (int lane = 0; lane < group.lanes; ++lane) {
+        steps = std::max(steps, group.planes[lane]->levels - 1);
+    }
+    for (int lane = 0; lane < kDiffusionLanes; ++lane) {
+        const InkPlane* plane = lane < group.lanes ? group.planes[lane] : nullptr;
+        for (int i = 0; i < steps; ++i) {
+            if (plane && i + 1 < plane->levels) {
+                const qint32 low = static_cast<qint32>(std::lround(plane->drops[i] * (1 << kFixedErrorBits)));
+                const qint32 high = static_cast<qint32>(std::lround(plane->drops[i + 1] * (1 << kFixedErrorBits)));
+                thresholds[i][lane] = low + high - 1;
+                deltas[i][lane] = high - low;
+            } else {
+                thresholds[i][lane] = INT_MAX;
+                deltas[i][lane] = 0;
+            }
+        }
+    }
+    return steps;
+}
+
+#ifdef RIP_SSE_DIFFUSION
+// Adds the share of one tap after the first and sums it into 'spread'.
+// 'error16' holds the saturated errors in the low half of each lane.
+template <class Kernel, bool Reverse, std::size_t Tap>
+static inline void addFixedTap(__m128i error16, qint32* const* lines, int x, __m128i& spread) {
+    constexpr DiffusionTap tap = Kernel::taps[Tap];
+    const __m128i product = _mm_madd_epi16(error16, _mm_set1_epi32(fixedWeight<Kernel, Tap>()));
+    const __m128i share = _mm_srai_epi32(_mm_add_epi32(product, _mm_set1_epi32(1 << (kFixedWeightBits - 1))),
+                                         kFixedWeightBits);
+    __m128i* target = reinterpret_cast<__m128i*>(lines[tap.dy] + (x + (Reverse ? -tap.dx : tap.dx)) * kDiffusionLanes);
+    _mm_storeu_si128(target, _mm_add_epi32(_mm_loadu_si128(target), share));
+    spread = _mm_add_epi32(spread, share);
+}
+
+template <class Kernel, bool Reverse, std::size_t... Tap>
+static inline void spreadFixedError(__m128i error, qint32* const* lines, int x, std::index_sequence<Tap...>) {
+    const __m128i saturated = _mm_packs_epi32(error, error);
+    const __m128i error16 = _mm_unpacklo_epi16(saturated, _mm_setzero_si128());
+    __m128i spread = _mm_setzero_si128();
+    (addFixedTap<Kernel, Reverse, Tap + 1>(error16, lines, x, spread), ...);
+
+    constexpr DiffusionTap first = Kernel::taps[0];
+    const __m128i rest = _mm_sub_epi32(_mm_srai_epi32(_mm_unpacklo_epi16(saturated, saturated), 16), spread);
+    __m128i* target = reinterpret_cast<__m128i*>(lines[first.dy] + (x + (Reverse ? -first.dx : first.dx)) * kDiffusionLanes);
+    _mm_storeu_si128(target, _mm_add_epi32(_mm_loadu_si128(target), rest));
+}
+#else
+template <class Kernel, bool Reverse, std::size_t Tap>
+static inline qint32 addFixedTap(qint32 error, qint32* const* lines, int x, int lane) {
+    constexpr DiffusionTap tap = Kernel::taps[Tap];
+    const qint32 share = (error * fixedWeight<Kernel, Tap>() + (1 << (kFixedWeightBits - 1))) >> kFixedWeightBits;
+    lines[tap.dy][(x + (Reverse ? -tap.dx : tap.dx)) * kDiffusionLanes + lane] += share;
+    return share;
+}
+
+template <class Kernel, bool Reverse, std::size_t... Tap>
+static inline void spreadFixedError(qint32 error, qint32* const* lines, int x, int lane, std::index_sequence<Tap...>) {
+    error = std::clamp(error, -32768, 32767);
+    const qint32 spread = (0 + ... + addFixedTap<Kernel, Reverse, Tap + 1>(error, lines, x, lane));
+
+    constexpr DiffusionTap first = Kernel::taps[0];
+    lines[first.dy][(x + (Reverse ? -first.dx : first.dx)) * kDiffusionLanes + lane] += error - spread;
+}
+#endif
+
+template <class Kernel, bool Reverse>
+static void diffuseBlockFixed(const uchar* inputRow, const DiffusionGroup& group,
+                              void* const* errorLines, int, int, int x0, int x1,
+                              uchar* levels, int levelStride) {
+    constexpr auto taps = std::make_index_sequence<std::size(Kernel::taps) - 1>();
+    qint32* lines[Kernel::rows];
+    for (int k = 0; k < Kernel::rows; ++k) {
+        lines[k] = static_cast<qint32*>(errorLines[k]);
+    }
+    qint32* currentErrors = lines[0];
+
+    alignas(16) qint32 thresholds[kMaxOutputLevels - 1][kDiffusionLanes];
+    alignas(16) qint32 deltas[kMaxOutputLevels - 1][kDiffusionLanes];
+    const int steps = fixedSteps(group, thresholds, deltas);
+
+    for (int i = 0; i < x1 - x0; ++i) {
+        const int x = Reverse ? x1 - 1 - i : x0 + i;
+        const uchar* pixel = inputRow + x * 4;
+        qint32 input[kDiffusionLanes] = {};
+        for (int lane = 0; lane < group.lanes; ++lane) {
+            input[lane] = group.planes[lane]->lut[pixel[group.planes[lane]->source]];
+        }
+
+#ifdef RIP_SSE_DIFFUSION
+        // Ink amounts of the four planes, then their codes and drops by
+        // counting the steps they pass
+        const __m128i value = _mm_add_epi32(_mm_slli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input)), kFixedErrorBits),
+                                            _mm_loadu_si128(reinterpret_cast<const __m128i*>(currentErrors + x * kDiffusionLanes)));
+        const __m128i twice = _mm_add_epi32(value, value);
+        __m128i code = _mm_setzero_si128();
+        __m128i drop = _mm_setzero_si128();
+        for (int s = 0; s < steps; ++s) {
+            const __m128i above = _mm_cmpgt_epi32(twice, _mm_load_si128(reinterpret_cast<const __m128i*>(thresholds[s])));
+            code = _mm_sub_epi32(code, above);
+            drop = _mm_add_epi32(drop, _mm_and_si128(above, _mm_load_si128(reinterpret_cast<const __m128i*>(deltas[s]))));
+        }
+        const __m128i code16 = _mm_packs_epi32(code, code);
+        const quint32 codes = static_cast<quint32>(_mm_cvtsi128_si32(_mm_packus_epi16(code16, code16)));
+        for (int lane = 0; lane < group.lanes; ++lane) {
+            levels[lane * levelStride + x - x0] = static_cast<uchar>(codes >> (lane * 8));
+        }
+
+        // Distribute the errors to neighboring pixels (past the edges into the
+        // guards; after the last row into unused lines)
+        spreadFixedError<Kernel, Reverse>(_mm_sub_epi32(value, drop), lines, x, taps);
+#else
+        for (int lane = 0; lane < group.lanes; ++lane) {
+            const qint32 value = (input[lane] << kFixedErrorBits) + currentErrors[x * kDiffusionLanes + lane];
+
+            // Quantize the pixel
+            int code = 0;
+            qint32 drop = 0;
+            for (int s = 0; s < steps; ++s) {
+                if (2 * value > thresholds[s][lane]) {
+                    ++code;
+                    drop += deltas[s][lane];
+                }
+            }
+            levels[lane * levelStride + x - x0] = static_cast<uchar>(code);
+
+            // Distribute the error to neighboring pixels
+            spreadFixedError<Kernel, Reverse>(value - drop, lines, x, lane, taps);
+        }
+#endif
+    }
+}
+
+// Variable-coefficient kernels (after Ostromoukhov). Three taps, right,
+// down-left and down, with weights that depend on the tone of the input pixel:
+// a fixed set of weights locks into regular textures at some tones, and moving
+// the weights with the tone breaks them up. The weights come from a table of
+// every tone, so a pixel costs one lookup per lane. The modulated variant also
+// jitters the quantization threshold with noise, most around mid-grey (after
+// Zhou and Fang), which breaks up the worm patterns left there.
+
+// Per-tone table: right, down-left and down weights and the modulation, as
+// floats (modulation in steps) and in fixed point (weights in 1/4096,
+// modulation in 1/128 step), one 16-byte row per tone
+struct VariableCoefficients {
+    alignas(16) float weights[256][4];
+    alignas(16) qint32 fixedWeights[256][4];
+};
+
+static VariableCoefficients buildVariableCoefficients() {
+    VariableCoefficients table;
+    for (int tone = 0; tone < 256; ++tone) {
+        const int mirrored = std::min(tone, 255 - tone);
+        int key = 0;
+        while (kVariableDiffusionKeys[key + 1].tone < mirrored) {
+            ++key;
+        }
+        const VariableDiffusionKey &low = kVariableDiffusionKeys[key];
+        const VariableDiffusionKey &high = kVariableDiffusionKeys[key + 1];
+        const float f = static_cast<float>(mirrored - low.tone) / (high.tone - low.tone);
+        const float right = low.right + (high.right - low.right) * f;
+        const float downLeft = low.downLeft + (high.downLeft - low.downLeft) * f;
+        const float down = low.down + (high.down - low.down) * f;
+        const float modulation = low.modulation + (high.modulation - low.modulation) * f;
+        const float sum = right + downLeft + down;
+
+        const float entry[4] = { right / sum, downLeft / sum, down / sum, modulation / 128.0f };
+        for (int i = 0; i < 4; ++i) {
+            table.weights[tone][i] = entry[i];
+            table.fixedWeights[tone][i] = static_cast<qint32>(std::lround(i < 3 ? entry[i] * (1 << kFixedWeightBits) : modulation));
+        }
+    }
+    return table;
+}
+
+static const VariableCoefficients kVariableCoefficients = buildVariableCoefficients();
+
+const float* VariableDiffusionWeights(int tone) {
+    return kVariableCoefficients.weights[std::clamp(tone, 0, 255)];
+}
+
+const qint32* VariableDiffusionFixedWeights(int tone) {
+    return kVariableCoefficients.fixedWeights[std::clamp(tone, 0, 255)];
+}
+
+// Noise of pixel (x, y) of the group whose first plane is 'first': one byte
+// per lane from a hash of the position, the same for every split of the image
+static inline quint32 positionNoise(int x, int y, int first) {
+    quint32 h = static_cast<quint32>(x) * 0x9E3779B1u ^ static_cast<quint32>(y) * 0x85EBCA77u
+              ^ static_cast<quint32>(first) * 0xC2B2AE3Du;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    h *= 0x297A2D39u;
+    h ^= h >> 15;
+    return h;
+}
+
+// Mean drop step of every lane, the unit of the threshold modulation
+static void dropSteps(const DiffusionGroup& group, float* steps) {
+    for (int lane = 0; lane < kDiffusionLanes; ++lane) {
+        const InkPlane* plane = lane < group.lanes ? group.planes[lane] : nullptr;
+        steps[lane] = plane ? plane->drops[plane->levels - 1] / (plane->levels - 1) : 0.0f;
+    }
+}
+
+template <bool Reverse, bool Modulated>
+static void diffuseBlockVariable(const uchar* inputRow, const DiffusionGroup& group,
+                                 void* const* errorLines, int originX, int y, int x0, int x1,
+                                 uchar* levels, int levelStride) {
+    float* currentErrors = static_cast<float*>(errorLines[0]);
+    float* belowErrors = static_cast<float*>(errorLines[1]);
+    const int ahead = Reverse ? -1 : 1;
+
+    alignas(16) float steps[kDiffusionLanes];
+    dropSteps(group, steps);
+
+#ifdef RIP_SSE_DIFFUSION
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 full = _mm_set1_ps(255.0f);
+    const __m128 stepVector = _mm_load_ps(steps);
+#endif
+
+    for (int i = 0; i < x1 - x0; ++i) {
+        const int x = Reverse ? x1 - 1 - i : x0 + i;
+        const uchar* pixel = inputRow + x * 4;
+        float input[kDiffusionLanes] = {};
+        const float* coefficients[kDiffusionLanes];
+        for (int lane = 0; lane < kDiffusionLanes; ++lane) {
+            coefficients[lane] = kVariableCoefficients.weights[0];
+        }
+        for (int lane = 0; lane < group.lanes; ++lane) {
+            const uchar amount = group.planes[lane]->lut[pixel[group.planes[lane]->source]];
+            input[lane] = amount;
+            coefficients[lane] = kVariableCoefficients.weights[group.planes[lane]->tones[amount]];
+        }
+        const quint32 noise = Modulated ? positionNoise(originX + x, y, group.first) : 0;
+
+#ifdef RIP_SSE_DIFFUSION
+        // Weights of the four lanes, one tap per vector
+        __m128 right = _mm_load_ps(coefficients[0]);
+        __m128 downLeft = _mm_load_ps(coefficients[1]);
+        __m128 down = _mm_load_ps(coefficients[2]);
+        __m128 modulation = _mm_load_ps(coefficients[3]);
+        _MM_TRANSPOSE4_PS(right, downLeft, down, modulation);
+
+        // Quantize the (modulated) ink amounts through the tables
+        __m128 oldPixel = _mm_add_ps(_mm_loadu_ps(input), _mm_loadu_ps(currentErrors + x * kDiffusionLanes));
+        __m128 probe = oldPixel;
+        if (Modulated) {
+            const __m128i bytes = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(noise)), _mm_setzero_si128());
+            const __m128 jitter = _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(bytes, _mm_setzero_si128())),
+                                                        _mm_set1_ps(127.5f)), _mm_set1_ps(1.0f / 128));
+            probe = _mm_add_ps(oldPixel, _mm_mul_ps(_mm_mul_ps(jitter, modulation), stepVector));
+        }
+        alignas(16) qint32 amounts[kDiffusionLanes];
+        _mm_store_si128(reinterpret_cast<__m128i*>(amounts),
+                        _mm_cvttps_epi32(roundHalfAway(_mm_min_ps(_mm_max_ps(probe, zero), full))));
+        float newPixel[kDiffusionLanes] = {};
+        for (int lane = 0; lane < group.lanes; ++lane) {
+            uchar code;
+            newPixel[lane] = quantize(group.planes[lane], amounts[lane], code);
+            levels[lane * levelStride + x - x0] = code;
+        }
+
+        // Distribute the errors (past the edges into the guards)
+        const __m128 error = _mm_sub_ps(oldPixel, _mm_loadu_ps(newPixel));
+        float* targets[3] = { currentErrors + (x + ahead) * kDiffusionLanes, belowErrors + (x - ahead) * kDiffusionLanes,
+                              belowErrors + x * kDiffusionLanes };
+        _mm_storeu_ps(targets[0], _mm_add_ps(_mm_loadu_ps(targets[0]), _mm_mul_ps(error, right)));
+        _mm_storeu_ps(targets[1], _mm_add_ps(_mm_loadu_ps(targets[1]), _mm_mul_ps(error, downLeft)));
+        _mm_storeu_ps(targets[2], _mm_add_ps(_mm_loadu_ps(targets[2]), _mm_mul_ps(error, down)));
+#else
+        for (int lane = 0; lane < group.lanes; ++lane) {
+            const float* weights = coefficients[lane];
+            float oldPixel = input[lane] + currentErrors[x * kDiffusionLanes + lane];
+            float probe = oldPixel;
+            if (Modulated) {
+                const float jitter = (static_cast<float>((noise >> (lane * 8)) & 0xFF) - 127.5f) * (1.0f / 128);
+                probe = oldPixel + jitter * weights[3] * steps[lane];
+            }
+
+            // Quantize the pixel
+            uchar code;
+            const int amount = static_cast<int>(std::round(std::clamp(probe, 0.0f, 255.0f)));
+            const float error = oldPixel - quantize(group.planes[lane], amount, code);
+            levels[lane * levelStride + x - x0] = code;
+
+            // Distribute the error to neighboring pixels
+            currentErrors[(x + ahead) * kDiffusionLanes + lane] += error * weights[0];
+            belowErrors[(x - ahead) * kDiffusionLanes + lane] += error * weights[1];
+            belowErrors[x * kDiffusionLanes + lane] += error * weights[2];
+        }
+#endif
+    }
+}
+
+// Fixed-point variant of the variable kernels, with the same rounding and
+// exact error conservation as the fixed kernels (the right tap takes what the
+// others leave). The modulation is noise * modulation * step >> 15, in 1/32
+// ink level.
+template <bool Reverse, bool Modulated>
+static void diffuseBlockVariableFixed(const uchar* inputRow, const DiffusionGroup& group,
+                                      void* const* errorLines, int originX, int y, int x0, int x1,
+                                      uchar* levels, int levelStride) {
+    qint32* currentErrors = static_cast<qint32*>(errorLines[0]);
+    qint32* belowErrors = static_cast<qint32*>(errorLines[1]);
+    const int ahead = Reverse ? -1 : 1;
+
+    alignas(16) qint32 thresholds[kMaxOutputLevels - 1][kDiffusionLanes];
+    alignas(16) qint32 deltas[kMaxOutputLevels - 1][kDiffusionLanes];
+    const int steps = fixedSteps(group, thresholds, deltas);
+    alignas(16) float dropStep[kDiffusionLanes];
+    alignas(16) qint32 fixedStep[kDiffusionLanes];
+    dropSteps(group, dropStep);
+    for (int lane = 0; lane < kDiffusionLanes; ++lane) {
+        fixedStep[lane] = static_cast<qint32>(std::lround(dropStep[lane] * (1 << kFixedErrorBits)));
+    }
+
+#ifdef RIP_SSE_DIFFUSION
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi32(1 << (kFixedWeightBits - 1));
+    const __m128i stepVector = _mm_load_si128(reinterpret_cast<const __m128i*>(fixedStep));
+#endif
+
+    for (int i = 0; i < x1 - x0; ++i) {
+        const int x = Reverse ? x1 - 1 - i : x0 + i;
+        const uchar* pixel = inputRow + x * 4;
+        qint32 input[kDiffusionLanes] = {};
+        const qint32* coefficients[kDiffusionLanes];
+        for (int lane = 0; lane < kDiffusionLanes; ++lane) {
+            coefficients[lane] = kVariableCoefficients.fixedWeights[0];
+        }
+        for (int lane = 0; lane < group.lanes; ++lane) {
+            const uchar amount = group.planes[lane]->lut[pixel[group.planes[lane]->source]];
+            input[lane] = amount;
+            coefficients[lane] = kVariableCoefficients.fixedWeights[group.planes[lane]->tones[amount]];
+        }
+        const quint32 noise = Modulated ? positionNoise(originX + x, y, group.first) : 0;
+
+#ifdef RIP_SSE_DIFFUSION
+        // Weights of the four lanes, one tap per vector
+        __m128 rows[4];
+        for (int lane = 0; lane < kDiffusionLanes; ++lane) {
+            rows[lane] = _mm_castsi128_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(coefficients[lane])));
+        }
+        _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+        const __m128i downLeft = _mm_castps_si128(rows[1]);
+        const __m128i down = _mm_castps_si128(rows[2]);
+
+        // Count the steps the (modulated) value passes
+        const __m128i value = _mm_add_epi32(_mm_slli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input)), kFixedErrorBits),
+                                            _mm_loadu_si128(reinterpret_cast<const __m128i*>(currentErrors + x * kDiffusionLanes)));
+        __m128i probe = value;
+        if (Modulated) {
+            const __m128i bytes = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(noise)), zero), zero);
+            const __m128i jitter = _mm_sub_epi32(_mm_add_epi32(bytes, bytes), _mm_set1_epi32(255));
+            const __m128i scaled = _mm_madd_epi16(_mm_madd_epi16(jitter, _mm_castps_si128(rows[3])), stepVector);
+            probe = _mm_add_epi32(value, _mm_srai_epi32(scaled, 15));
+        }
+        const __m128i twice = _mm_add_epi32(probe, probe);
+        __m128i code = zero;
+        __m128i drop = zero;
+        for (int s = 0; s < steps; ++s) {
+            const __m128i above = _mm_cmpgt_epi32(twice, _mm_load_si128(reinterpret_cast<const __m128i*>(thresholds[s])));
+            code = _mm_sub_epi32(code, above);
+            drop = _mm_add_epi32(drop, _mm_and_si128(above, _mm_load_si128(reinterpret_cast<const __m128i*>(deltas[s]))));
+        }
+        const __m128i code16 = _mm_packs_epi32(code, code);
+        const quint32 codes = static_cast<quint32>(_mm_cvtsi128_si32(_mm_packus_epi16(code16, code16)));
+        for (int lane = 0; lane < group.lanes; ++lane) {
+            levels[lane * levelStride + x - x0] = static_cast<uchar>(codes >> (lane * 8));
+        }
+
+        // Distribute the saturated errors (past the edges into the guards)
+        const __m128i error = _mm_sub_epi32(value, drop);
+        const __m128i saturated = _mm_packs_epi32(error, error);
+        const __m128i error16 = _mm_unpacklo_epi16(saturated, zero);
+        const __m128i downLeftShare = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(error16, downLeft), half), kFixedWeightBits);
+        const __m128i downShare = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(error16, down), half), kFixedWeightBits);
+        const __m128i rightShare = _mm_sub_epi32(_mm_sub_epi32(_mm_srai_epi32(_mm_unpacklo_epi16(saturated, saturated), 16),
+                                                               downLeftShare), downShare);
+        __m128i* targets[3] = { reinterpret_cast<__m128i*>(currentErrors + (x + ahead) * kDiffusionLanes),
+                                reinterpret_cast<__m128i*>(belowErrors + (x - ahead) * kDiffusionLanes),
+                                reinterpret_cast<__m128i*>(belowErrors + x * kDiffusionLanes) };
+        _mm_storeu_si128(targets[0], _mm_add_epi32(_mm_loadu_si128(targets[0]), rightShare));
+        _mm_storeu_si128(targets[1], _mm_add_epi32(_mm_loadu_si128(targets[1]), downLeftShare));
+        _mm_storeu_si128(targets[2], _mm_add_epi32(_mm_loadu_si128(targets[2]), downShare));
+#else
+        for (int lane = 0; lane < group.lanes; ++lane) {
+            const qint32* weights = coefficients[lane];
+            const qint32 value = (input[lane] << kFixedErrorBits) + currentErrors[x * kDiffusionLanes + lane];
+            qint32 probe = value;
+            if (Modulated) {
+                const qint32 jitter = 2 * static_cast<qint32>((noise >> (lane * 8)) & 0xFF) - 255;
+                probe = value + ((jitter * weights[3] * fixedStep[lane]) >> 15);
+            }
+
+            // Quantize the pixel
+            int code = 0;
+            qint32 drop = 0;
+            for (int s = 0; s < steps; ++s) {
+                if (2 * probe > thresholds[s][lane]) {
+                    ++code;
+                    drop += deltas[s][lane];
+                }
+            }
+            levels[lane * levelStride + x - x0] = static_cast<uchar>(code);
+
+            // Distribute the error to neighboring pixels
+            const qint32 error = std::clamp(value - drop, -32768, 32767);
+            const qint32 downLeftShare = (error * weights[1] + (1 << (kFixedWeightBits - 1))) >> kFixedWeightBits;
+            const qint32 downShare = (error * weights[2] + (1 << (kFixedWeightBits - 1))) >> kFixedWeightBits;
+            currentErrors[(x + ahead) * kDiffusionLanes + lane] += error - downLeftShare - downShare;
+            belowErrors[(x - ahead) * kDiffusionLanes + lane] += downLeftShare;
+            belowErrors[x * kDiffusionLanes + lane] += downShare;
+        }
+#endif
+    }
+}
+
+template <class Kernel>
+static constexpr DiffusionKernelInfo kernelInfo() {
+    return { Kernel::rows, Kernel::reach, &diffuseBlock<Kernel, false>, &diffuseBlock<Kernel, true> };
+}
+
+template <class Kernel>
+static constexpr DiffusionKernelInfo fixedKernelInfo() {
+    return { Kernel::rows, Kernel::reach, &diffuseBlockFixed<Kernel, false>, &diffuseBlockFixed<Kernel, true> };
+}
+
+// Every kernel, indexed by DiffusionKernel
+static const DiffusionKernelInfo kDiffusionKernels[] = {
+    kernelInfo<FloydSteinbergKernel>(),
+    kernelInfo<JarvisJudiceNinkeKernel>(),
+    kernelInfo<StuckiKernel>(),
+    kernelInfo<Sierra3Kernel>(),
+    kernelInfo<Sierra2Kernel>(),
+    kernelInfo<SierraLiteKernel>(),
+    { 2, 1, &diffuseBlockVariable<false, false>, &diffuseBlockVariable<true, false> },
+    { 2, 1, &diffuseBlockVariable<false, true>, &diffuseBlockVariable<true, true> }
+};
+
+static const DiffusionKernelInfo kFixedDiffusionKernels[] = {
+    fixedKernelInfo<FloydSteinbergKernel>(),
+    fixedKernelInfo<JarvisJudiceNinkeKernel>(),
+    fixedKernelInfo<StuckiKernel>(),
+    fixedKernelInfo<Sierra3Kernel>(),
+    fixedKernelInfo<Sierra2Kernel>(),
+    fixedKernelInfo<SierraLiteKernel>(),
+    { 2, 1, &diffuseBlockVariableFixed<false, false>, &diffuseBlockVariableFixed<true, false> },
+    { 2, 1, &diffuseBlockVariableFixed<false, true>, &diffuseBlockVariableFixed<true, true> }
+};
+
+DiffusionKernelInfo SelectDiffusionKernel(int kernel, bool fixedPoint) {
+    kernel = std::clamp(kernel, 0, static_cast<int>(std::size(kDiffusionKernels)) - 1);
+    return fixedPoint ? kFixedDiffusionKernels[kernel] : kDiffusionKernels[kernel];
+}
@@ -0,0 +1,338 @@
+#include "InkCurves.h"
+#include <QStringList>
+#include <QDebug>
+#include <QFile>
+#include <QXmlStreamReader>
+#include <QMap>
+#include <algorithm>
+#include <cmath>
+
+void BuildSplitCurve(uchar* lut, int start, int peak, int endLevel)
+{
+    start = std::clamp(start, 0, 254);
+    peak = std::clamp(peak, start + 1, 255);
+    endLevel = std::clamp(endLevel, 0, 255);
+
+    for (int v = 0; v < 256; ++v) {
+        float amount;
+        if (v <= start) {
+            amount = 0.0f;
+        } else if (v <= peak) {
+            amount = 255.0f * (v - start) / (peak - start);
+        } else {
+            amount = 255.0f + (endLevel - 255.0f) * (v - peak) / (255 - peak);
+        }
+        lut[v] = static_cast<uchar>(std::clamp(std::round(amount), 0.0f, 255.0f));
+    }
+}
+
+bool BuildPointCurve(uchar* lut, const QString& points)
+{
+    for (int v = 0; v < 256; ++v) {
+        lut[v] = static_cast<uchar>(v);
+    }
+
+    // Parse the control points
+    QVector<QPair<int, int>> controlPoints;
+    for (const QString& point : points.split(",", Qt::SkipEmptyParts)) {
+        QStringList values = point.split(":");
+        bool okIn = false;
+        bool okOut = false;
+        int in = values.size() == 2 ? values[0].trimmed().toInt(&okIn) : 0;
+        int out = values.size() == 2 ? values[1].trimmed().toInt(&okOut) : 0;
+        if (!okIn || !okOut || in < 0 || in > 255) {
+            qWarning() << "Invalid curve point:" << point;
+            return false;
+        }
+        controlPoints.append(qMakePair(in, std::clamp(out, 0, 255)));
+    }
+    if (controlPoints.isEmpty()) {
+        return false;
+    }
+    std::sort(controlPoints.begin(), controlPoints.end());
+
+    // Interpolate between the control points, holding the end values flat
+    int segment = 0;
+    for (int v = 0; v < 256; ++v) {
+        while (segment + 1 < controlPoints.size() && controlPoints[segment + 1].first <= v) {
+            ++segment;
+        }
+        const QPair<int, int>& p0 = controlPoints[segment];
+        float value = static_cast<float>(p0.second);
+        if (v > p0.first && segment + 1 < controlPoints.size()) {
+            const QPair<int, int>& p1 = controlPoints[segment + 1];
+            value += static_cast<float>(p1.second - p0.second) * (v - p0.first) / (p1.first - p0.first);
+        } else if (v < p0.first) {
+            value = static_cast<float>(controlPoints.first().second);
+        }
+        lut[v] = static_cast<uchar>(std::clamp(std::round(value), 0.0f, 255.0f));
+    }
+    return true;
+}
+
+void BuildToneCurve(uchar* lut, const QString& points, int brightness, int contrast)
+{
+    uchar curve[256];
+    if (points.isEmpty() || !BuildPointCurve(curve, points)) {
+        for (int v = 0; v < 256; ++v) {
+            curve[v] = static_cast<uchar>(v);
+        }
+    }
+
+    brightness = std::clamp(brightness, -100, 100);
+    contrast = std::clamp(contrast, -100, 99);
+    const float offset = brightness * 127.5f / 100.0f;
+    const float slope = contrast <= 0 ? (100.0f + contrast) / 100.0f : 100.0f / (100.0f - contrast);
+
+    for (int v = 0; v < 256; ++v) {
+        float value = (curve[v] + offset - 127.5f) * slope + 127.5f;
+        lut[v] = static_cast<uchar>(std::clamp(std::round(value), 0.0f, 255.0f));
+    }
+}
+
+bool ApplyCalibration(QVector<InkPlane>& planes, const QString& calibrationFile, int nLevel)
+{
+    QFile file(calibrationFile);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning() << "Failed to open calibration file:" << calibrationFile;
+        return false;
+    }
+
+    // Collect the curve and ink limit of every ink for this output mode. A block
+    // for the exact level count wins over a block without a levels attribute.
+    QMap<QString, QString> curves;
+    QMap<QString, float> limits;
+    QMap<QString, bool> exactMatch;
+    bool inBlock = false;
+    bool blockExact = false;
+
+    QXmlStreamReader xml(&file);
+    while (!xml.atEnd()) {
+        xml.readNext();
+        if (xml.isStartElement()) {
+            if (xml.name() == "Curves") {
+                QString levels = xml.attributes().value("levels").toString();
+                blockExact = !levels.isEmpty();
+                inBlock = levels.isEmpty() || levels.toInt() == nLevel;
+            } else if (inBlock && xml.name() != "calibration") {
+                QString ink = xml.name().toString();
+                QString limit = xml.attributes().value("limit").toString();
+                QString points = xml.readElementText();
+                if (exactMatch.value(ink, false) && !blockExact) {
+                    continue;
+                }
+                exactMatch[ink] = blockExact;
+                curves[ink] = points;
+                limits[ink] = limit.isEmpty() ? 100.0f : std::clamp(limit.toFloat(), 0.0f, 100.0f);
+            }
+        } else if (xml.isEndElement() && xml.name() == "Curves") {
+            inBlock = false;
+        }
+    }
+
+    if (xml.hasError()) {
+        qWarning() << "Invalid calibration file:" << calibrationFile << xml.errorString();
+        file.close();
+        return false;
+    }
+    file.close();
+
+    // Compose linearization and ink restriction after the split table of each plane
+    for (InkPlane& plane : planes) {
+        if (!curves.contains(plane.name)) {
+            continue;
+        }
+
+        uchar linearization[256];
+        BuildPointCurve(linearization, curves[plane.name]);
+        const float scale = limits[plane.name] / 100.0f;
+
+        for (int v = 0; v < 256; ++v) {
+            plane.lut[v] = static_cast<uchar>(std::round(linearization[plane.lut[v]] * scale));
+        }
+    }
+
+    return true;
+}
+
+bool BuildLevelTable(InkPlane& plane, int levels, const QString& drops)
+{
+    // Evenly spaced drops, the same values the quantization step gives
+    plane.levels = std::clamp(levels, 2, kMaxOutputLevels);
+    const float step = 255.0f / (plane.levels - 1);
+    for (int i = 0; i < plane.levels; ++i) {
+        plane.drops[i] = i * step;
+    }
+
+    bool valid = true;
+    if (!drops.isEmpty()) {
+        QStringList parts = drops.split(",");
+        float densities[kMaxOutputLevels];
+        valid = parts.size() >= 2 && parts.size() <= kMaxOutputLevels;
+        for (int i = 0; valid && i < parts.size(); ++i) {
+            bool ok = false;
+            densities[i] = parts[i].trimmed().toFloat(&ok);
+            valid = ok && densities[i] <= 255.0f && (i == 0 ? densities[i] == 0.0f : densities[i] > densities[i - 1]);
+        }
+        if (valid) {
+            plane.levels = parts.size();
+            std::copy(densities, densities + plane.levels, plane.drops);
+        } else {
+            qWarning() << "Invalid drop densities for" << plane.name << ":" << drops;
+        }
+    }
+
+    // Nearest drop of every ink amount; a tie goes to the larger drop, as
+    // rounding half away from zero does
+    int code = 0;
+    for (int v = 0; v < 256; ++v) {
+        while (code + 1 < plane.levels && v - plane.drops[code] >= plane.drops[code + 1] - v) {
+            ++code;
+        }
+        plane.nearest[v] = static_cast<uchar>(code);
+    }
+
+    // Tone of every ink amount: where it lies between the drops below and
+    // above it, as if those were the only two codes of a bilevel plane
+    int low = 0;
+    for (int v = 0; v < 256; ++v) {
+        while (low + 2 < plane.levels && v >= plane.drops[low + 1]) {
+            ++low;
+        }
+        const float tone = (v - plane.drops[low]) / (plane.drops[low + 1] - plane.drops[low]);
+        plane.tones[v] = static_cast<uchar>(std::round(std::clamp(tone, 0.0f, 1.0f) * 255.0f));
+    }
+    return valid;
+}
+
+int OutputLevels(const QVector<InkPlane>& planes)
+{
+    int levels = 2;
+    for (const InkPlane& plane : planes) {
+        levels = std::max(levels, plane.levels);
+    }
+    return levels;
+}
+
+int BuildLevelTables(QVector<InkPlane>& planes, int nLevel, const QStringList& drops)
+{
+    // The planes with a valid drop density setting first: they set the job
+    // level count, which a table of more than 'nLevel' codes raises
+    QVector<bool> hasDrops(planes.size(), false);
+    int levels = std::clamp(nLevel, 2, kMaxOutputLevels);
+    for (int i = 0; i < planes.size(); ++i) {
+        if (i < drops.size() && !drops[i].isEmpty()) {
+            hasDrops[i] = BuildLevelTable(planes[i], nLevel, drops[i]);
+            if (hasDrops[i]) {
+                levels = std::max(levels, planes[i].levels);
+            }
+        }
+    }
+
+    // The other planes use every code of the file, or they would print only
+    // the smallest drops of a wider pixel
+    for (int i = 0; i < planes.size(); ++i) {
+        if (!hasDrops[i]) {
+            BuildLevelTable(planes[i], levels, QString());
+        }
+    }
+    return levels;
+}
+
+// Parse a "start,peak,end" split setting, falling back to the given defaults
+static void ParseSplit(const QString& text, int& start, int& peak, int& endLevel)
+{
+    if (text.isEmpty()) {
+        return;
+    }
+
+    QStringList parts = text.split(",");
+    if (parts.size() != 3) {
+        qWarning() << "Invalid ink split setting:" << text;
+        return;
+    }
+
+    int values[3];
+    for (int i = 0; i < 3; ++i) {
+        bool ok = false;
+        values[i] = parts[i].trimmed().toInt(&ok);
+        if (!ok) {
+            qWarning() << "Invalid ink split setting:" << text;
+            return;
+        }
+    }
+    start = values[0];
+    peak = values[1];
+    endLevel = values[2];
+}
+
+static InkPlane MakePlane(const QString& name, int source)
+{
+    InkPlane plane;
+    plane.name = name;
+    plane.source = source;
+    for (int v = 0; v < 256; ++v) {
+        plane.lut[v] = static_cast<uchar>(v);
+    }
+    return plane;
+}
+
+static void ApplySplit(const JobSettings& settings, InkPlane& plane, int start, int peak, int endLevel)
+{
+    ParseSplit(settings.inkSplit(plane.name), start, peak, endLevel);
+    BuildSplitCurve(plane.lut, start, peak, endLevel);
+}
+
+QVector<InkPlane> BuildInkPlanes(const JobSettings& settings, int nLevel)
+{
+    QVector<InkPlane> planes;
+    planes.append(MakePlane("C", 0));
+    planes.append(MakePlane("M", 1));
+    planes.append(MakePlane("Y", 2));
+    planes.append(MakePlane("K", 3));
+
+    // Two-way splits: the light ink covers the highlights, the dark ink takes over
+    // in the shadows
+    if (settings.lc()) {
+        InkPlane light = MakePlane("Lc", 0);
+        ApplySplit(settings, planes[0], 64, 255, 255);
+        ApplySplit(settings, light, 0, 128, 64);
+        planes.append(light);
+    }
+    if (settings.lm()) {
+        InkPlane light = MakePlane("Lm", 1);
+        ApplySplit(settings, planes[1], 64, 255, 255);
+        ApplySplit(settings, light, 0, 128, 64);
+        planes.append(light);
+    }
+
+    // Black can be split two ways (K + Lk or K + LLk) or three ways (K + Lk + LLk)
+    if (settings.lk() && settings.llk()) {
+        InkPlane light = MakePlane("Lk", 3);
+        InkPlane lightLight = MakePlane("LLk", 3);
+        ApplySplit(settings, planes[3], 120, 255, 255);
+        ApplySplit(settings, light, 40, 160, 64);
+        ApplySplit(settings, lightLight, 0, 80, 32);
+        planes.append(light);
+        planes.append(lightLight);
+    } else if (settings.lk() || settings.llk()) {
+        InkPlane light = MakePlane(settings.lk() ? "Lk" : "LLk", 3);
+        ApplySplit(settings, planes[3], 64, 255, 255);
+        ApplySplit(settings, light, 0, 128, 64);
+        planes.append(light);
+    }
+
+    // Output codes of every plane
+    QStringList drops;
+    for (const InkPlane& plane : planes) {
+        drops.append(settings.inkDrops(plane.name));
+    }
+    BuildLevelTables(planes, nLevel, drops);
+
+    // Per-channel linearization and ink restriction from the calibration file
+    if (!settings.calibrationFile().isEmpty()) {
+        ApplyCalibration(planes, settings.calibrationFile(), OutputLevels(planes));
+    }
+
+    return planes;
+}
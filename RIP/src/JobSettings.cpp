@@ -13,6 +13,9 @@
 JobSettings::JobSettings()
     : m_header(0), m_dithering(0), m_xResolution(0.0f), m_yResolution(0.0f),
       m_widthPercentage(100.0f), m_heightPercentage(100.0f), m_width(0.0f), m_height(0.0f),
+      m_resampleFilter(0), m_diffusionKernel(0), m_serpentine(false), m_stripDiffusion(false),
+      m_fixedPointDiffusion(false), m_screenLpi(60.0f),
+      m_brightness(0), m_contrast(0), m_saturation(0),
       m_c(false), m_m(false), m_y(false), m_k(false),
       m_lc(false), m_lm(false), m_lk(false), m_llk(false),
       m_s1(false), m_s2(false), m_s3(false), m_s4(false), m_s5(false), m_s6(false)
@@ -78,6 +81,32 @@ void JobSettings::parseXml(QXmlStreamReader& xml)
         m_width = xml.readElementText().toFloat();
     } else if (xml.name() == "Height") {
         m_height = xml.readElementText().toFloat();
+    } else if (xml.name() == "ResampleFilter") {
+        m_resampleFilter = xml.readElementText().toInt();
+    } else if (xml.name() == "DiffusionKernel") {
+        m_diffusionKernel = xml.readElementText().toInt();
+    } else if (xml.name() == "Serpentine") {
+        m_serpentine = xml.readElementText().toInt() != 0;
+    } else if (xml.name() == "StripDiffusion") {
+        m_stripDiffusion = xml.readElementText().toInt() != 0;
+    } else if (xml.name() == "FixedPointDiffusion") {
+        m_fixedPointDiffusion = xml.readElementText().toInt() != 0;
+    } else if (xml.name() == "ScreenLpi") {
+        m_screenLpi = xml.readElementText().toFloat();
+    } else if (xml.name() == "CalibrationFile") {
+        m_calibrationFile = xml.readElementText();
+    } else if (xml.name() == "Brightness") {
+        m_brightness = xml.readElementText().toInt();
+    } else if (xml.name() == "Contrast") {
+        m_contrast = xml.readElementText().toInt();
+    } else if (xml.name() == "Saturation") {
+        m_saturation = xml.readElementText().toInt();
+    } else if (xml.name() == "RedCurve") {
+        m_redCurve = xml.readElementText();
+    } else if (xml.name() == "GreenCurve") {
+        m_greenCurve = xml.readElementText();
+    } else if (xml.name() == "BlueCurve") {
+        m_blueCurve = xml.readElementText();
     } else if (xml.name() == "Colors") {
         QStringList colors = xml.readElementText().split(",");
         m_c = colors.contains("C");
@@ -94,6 +123,14 @@ void JobSettings::parseXml(QXmlStreamReader& xml)
         m_s4 = colors.contains("S4");
         m_s5 = colors.contains("S5");
         m_s6 = colors.contains("S6");
+    } else if (xml.name().endsWith(QLatin1String("Split"))) {
+        QString ink = xml.name().toString();
+        ink.chop(5);
+        m_inkSplits[ink] = xml.readElementText();
+    } else if (xml.name().endsWith(QLatin1String("Drops"))) {
+        QString ink = xml.name().toString();
+        ink.chop(5);
+        m_inkDrops[ink] = xml.readElementText();
     }
 }
 #include <QFile>
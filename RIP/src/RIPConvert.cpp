@@ -1,5 +1,16 @@
 #include "include.h"
+#include "RIPConvert.h"
 #include "ProcessStruct.h"
+#include "Resampler.h"
+#include "ErrorDiffusion.h"
+#include "Screening.h"
+#include "BitPacking.h"
+#include <QImageReader>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <memory>
+#include <numeric>
 
 
 QByteArray convertRGBtoLAB(const QImage &image, const TagJobInfoRecord &jobInfo) {
@@ -240,148 +251,412 @@ QByteArray convertLABtoCMYK(const QByteArray &labDataBuf, const TagJobInfoRecord
     return cmykDataBuf;
 }
 
-QByteArray resizeCMYKData(const QByteArray &cmykDataBuf, const TagJobInfoRecord &jobInfo) {
-    if (cmykDataBuf.isEmpty() || jobInfo.width <= 0 || jobInfo.height <= 0 || jobInfo.xTimes <= 0 || jobInfo.yTimes <= 0) {
+// PRN line of a plane: the plane bytes padded to a multiple of 4
+static int prnLineBytes(const TagJobInfoRecord &jobInfo) {
+    return (jobInfo.bytePerLine + 3) / 4 * 4;
+}
+
+// Start of the line of plane 'plane' in row y of a PRN buffer. The lines of a
+// row go K, C, M, Y, then the light inks in plane order.
+static uchar* prnPlaneLine(uchar* prnData, const TagJobInfoRecord &jobInfo, int y, int plane) {
+    const int slot = plane < 4 ? (plane + 1) % 4 : plane;
+    const int nColors = jobInfo.inkPlanes.size();
+    return prnData + sizeof(tagHeadRecord_1) + (static_cast<qint64>(y) * nColors + slot) * prnLineBytes(jobInfo);
+}
+
+// Allocates the dithered output as the PRN file it is written as: the header
+// followed by the padded plane lines of every row, zero-filled so the padding
+// is in place. Sets the job's line length and output size.
+static QByteArray createPrnBuffer(TagJobInfoRecord &jobInfo, int bitsPerPixel) {
+    const int nColors = jobInfo.inkPlanes.size();
+    jobInfo.bytePerLine = (jobInfo.width * bitsPerPixel + 7) / 8;
+    jobInfo.outputBuffSize = sizeof(tagHeadRecord_1) + prnLineBytes(jobInfo) * jobInfo.height * nColors;
+    QByteArray prnBuf(jobInfo.outputBuffSize, 0);
+
+    // Populate the header structure
+    tagHeadRecord_1 header;
+    header.nSignature = 0x5555; // Signature
+    header.nXDPI = int(jobInfo.xImageResolution + 0.5);
+    header.nYDPI = int(jobInfo.yImageResolution + 0.5);
+    header.nBytesPerLine = prnLineBytes(jobInfo);
+    header.nHeight = jobInfo.height;
+    header.nWidth = jobInfo.width;
+    header.nPaperWidth = 0;     // Not used
+    header.nColors = nColors;   // CMYK + light inks
+    header.nBits = bitsPerPixel;
+    header.nReserved[0] = 0;    // Pass Number
+    header.nReserved[1] = 0;    // vsdMode
+    header.nReserved[2] = 0;    // Reserved
+    memcpy(prnBuf.data(), &header, sizeof(header));
+
+    return prnBuf;
+}
+
+// Scratch budget of the fused resize + dither stages. Resampled rows are written
+// into a ring of row slots of at most this size and dithered a few rows later,
+// while they are still in L2, so at printer resolution only the packed output
+// goes out to memory.
+static const int kDitherScratchBytes = 256 * 1024;
+
+// Pixels a wavefront row processes between two progress updates; a multiple
+// of 8 so every block packs into whole output bytes
+static const int kWavefrontBlock = 64;
+
+// Strip diffusion (job setting StripDiffusion) cuts the image into vertical
+// strips of this many pixels that are diffused independently, so a short,
+// wide job still has enough work in flight for every core. Each strip also
+// diffuses an apron of pixels on both sides and drops their output: the error
+// state it carries to its edges then looks like that of its neighbours and
+// the seams do not show. Both are multiples of kWavefrontBlock, so strips
+// and their blocks start on output byte boundaries.
+static const int kDiffusionStripWidth = 1024;
+static const int kDiffusionApron = 64;
+
+// Pixels of one strip: the output columns x0 .. x1 - 1 and the diffused
+// columns begin .. end - 1, which add the aprons inside the image
+struct DiffusionStrip {
+    int x0;
+    int x1;
+    int begin;
+    int end;
+};
+
+// Rows an error diffusion wavefront has in flight when it reads a same-size
+// input in place. They cost no scratch, only their error lines. Resampled rows
+// are bounded by the slots of the scratch budget instead.
+static const int kPassThroughRows = 32;
+
+// Resampled rows of 'rowLength' bytes that fit the scratch budget
+static int ditherRingRows(int rowLength) {
+    return std::clamp(kDitherScratchBytes / std::max(rowLength, 1), 1, 64);
+}
+
+QByteArray errorDiffusionDither(const QByteArray &cmykDataBuf, TagJobInfoRecord &jobInfo) {
+    if (cmykDataBuf.isEmpty() || jobInfo.width <= 0 || jobInfo.height <= 0) {
         qWarning() << "Invalid input parameters";
         return QByteArray();
     }
 
-    // Calculate new dimensions
-    int newWidth = static_cast<int>(std::round(jobInfo.width * jobInfo.xTimes));
-    int newHeight = static_cast<int>(std::round(jobInfo.height * jobInfo.yTimes));
+    // Same-size resampler: rows come straight from the input buffer
+    RowResampler rows(cmykDataBuf, jobInfo.width, jobInfo.height, jobInfo.width, jobInfo.height, ResampleBilinear);
+    return errorDiffusionDither(rows, jobInfo);
+}
 
-    if (newWidth <= 0 || newHeight <= 0) {
-        qWarning() << "Invalid output dimensions";
+QByteArray errorDiffusionDither(RowResampler &resampler, TagJobInfoRecord &jobInfo) {
+    if (!resampler.isValid() || jobInfo.level < 2 || jobInfo.level > kMaxOutputLevels) {
+        qWarning() << "Invalid input parameters";
         return QByteArray();
     }
 
-    // Create output buffer
-    QByteArray resizedCmykDataBuf(newWidth * newHeight * 4, Qt::Uninitialized);
-
-    // Get pointers to input and output data
-    const uchar* inputData = reinterpret_cast<const uchar*>(cmykDataBuf.constData());
-    uchar* outputData = reinterpret_cast<uchar*>(resizedCmykDataBuf.data());
-
-    // Function to process a single row
-    auto processRow = [&](int y) {
-        for (int x = 0; x < newWidth; ++x) {
-            // Calculate corresponding coordinates in the original image
-            float srcX = x / jobInfo.xTimes;
-            float srcY = y / jobInfo.yTimes;
-
-            // Get the four neighboring pixels
-            int x1 = static_cast<int>(srcX);
-            int y1 = static_cast<int>(srcY);
-            int x2 = std::min(x1 + 1, jobInfo.width - 1);
-            int y2 = std::min(y1 + 1, jobInfo.height - 1);
-
-            // Calculate weights for interpolation
-            float xWeight = srcX - x1;
-            float yWeight = srcY - y1;
-
-            // Process each channel (C, M, Y, K)
-            for (int c = 0; c < 4; ++c) {
-                // Perform bilinear interpolation
-                float v11 = inputData[(y1 * jobInfo.width + x1) * 4 + c];
-                float v21 = inputData[(y1 * jobInfo.width + x2) * 4 + c];
-                float v12 = inputData[(y2 * jobInfo.width + x1) * 4 + c];
-                float v22 = inputData[(y2 * jobInfo.width + x2) * 4 + c];
-
-                float v1 = v11 * (1 - xWeight) + v21 * xWeight;
-                float v2 = v12 * (1 - xWeight) + v22 * xWeight;
-                float value = v1 * (1 - yWeight) + v2 * yWeight;
-
-                // Clamp the value to the valid range [0, 255]
-                outputData[(y * newWidth + x) * 4 + c] = static_cast<uchar>(std::clamp(value, 0.0f, 255.0f));
-            }
-        }
-    };
+    // The output has the size of the resampled image
+    jobInfo.width = resampler.width();
+    jobInfo.height = resampler.height();
 
-    // Use a thread pool for parallel row processing
-    QThreadPool pool;
-    pool.setMaxThreadCount(QThread::idealThreadCount()); // Use all available cores
+    // Output buffer in the PRN layout
+    const int bitsPerPixel = BitsPerPixel(jobInfo.level);
+    const int nColors = jobInfo.inkPlanes.size();
+    QByteArray ditheringDataBuf = createPrnBuffer(jobInfo, bitsPerPixel);
+    uchar* outputData = reinterpret_cast<uchar*>(ditheringDataBuf.data());
 
-    QVector<int> rows(newHeight);
-    for (int y = 0; y < newHeight; ++y) {
-        rows[y] = y;
+    // Resampled rows. The main thread resamples into a ring of row slots that
+    // fits the scratch budget, while the diffusion works on the rows before;
+    // a slot is reused once every unit has finished its row. A same-size
+    // input is read in place, without any copy, so more of its rows can be in
+    // flight. Either way the rows in flight are fixed by the row length, not
+    // the core count.
+    const int width = jobInfo.width;
+    const int rowLength = width * 4;
+    const bool passThrough = resampler.isPassThrough();
+    const int ringRows = passThrough ? kPassThroughRows : ditherRingRows(rowLength);
+    QByteArray ringBuf;
+    if (!passThrough) {
+        ringBuf = QByteArray(ringRows * rowLength, Qt::Uninitialized);
+    }
+    uchar* ringData = reinterpret_cast<uchar*>(ringBuf.data());
+    const uchar* sourceData = passThrough ? resampler.row(0) : nullptr;
+
+    // Kernel of the job
+    const DiffusionKernelInfo kernel = SelectDiffusionKernel(jobInfo.diffusionKernel, jobInfo.fixedPointDiffusion);
+    const bool serpentine = jobInfo.serpentine;
+
+    // Planes in groups of four lanes
+    const int nGroups = (nColors + kDiffusionLanes - 1) / kDiffusionLanes;
+    QVector<DiffusionGroup> groups(nGroups);
+    for (int c = 0; c < nColors; ++c) {
+        DiffusionGroup &group = groups[c / kDiffusionLanes];
+        group.planes[c % kDiffusionLanes] = &jobInfo.inkPlanes[c];
+        group.lanes = c % kDiffusionLanes + 1;
+        group.first = c - c % kDiffusionLanes;
     }
 
-    QtConcurrent::blockingMap(rows, processRow);
+    // Strips of the image; without strip diffusion one strip of full rows
+    QVector<DiffusionStrip> strips;
+    const int stripWidth = jobInfo.stripDiffusion ? kDiffusionStripWidth : width;
+    int stripLength = 0;
+    for (int x0 = 0; x0 < width; x0 += stripWidth) {
+        DiffusionStrip strip;
+        strip.x0 = x0;
+        strip.x1 = std::min(width, x0 + stripWidth);
+        strip.begin = std::max(0, strip.x0 - kDiffusionApron);
+        strip.end = std::min(width, strip.x1 + kDiffusionApron);
+        stripLength = std::max(stripLength, strip.end - strip.begin);
+        strips.append(strip);
+    }
 
-    return resizedCmykDataBuf;
-}
+    // Each strip diffuses every group on its own; a unit is one (strip, group)
+    const int nUnits = strips.size() * nGroups;
+
+    // Rolling error lines of every unit: row y reads line y % linesPerGroup and
+    // diffuses into the lines below it, then clears its own line for reuse. One
+    // line per row in flight plus the lines the kernel reaches below the last.
+    const int linesPerGroup = ringRows + kernel.rows - 1;
+    const int lineBytes = (stripLength + 2 * kDiffusionGuard) * kDiffusionLanes * kDiffusionTermBytes;
+    QByteArray errorLines(nUnits * linesPerGroup * lineBytes, '\0');
+    uchar* errorData = reinterpret_cast<uchar*>(errorLines.data());
+
+    // Pixels finished by every unit in its rows y % progressRows: the rows in
+    // flight and the row above the first of them
+    const int progressRows = ringRows + 1;
+    std::unique_ptr<QAtomicInt[]> progress(new QAtomicInt[nUnits * progressRows]);
+
+    // Rows the main thread has made available, and the units finished with
+    // each ring row
+    QAtomicInt availableRows(0);
+    std::unique_ptr<QAtomicInt[]> finishedUnits(new QAtomicInt[ringRows]);
+
+    // Function to process one row of one unit. Rows of a unit run
+    // concurrently as a wavefront: pixel x of a row needs the errors the rows
+    // above spread from up to 'reach' pixels to its right, and shares its lines
+    // below with them, so a row waits until the row above has passed its
+    // current block by twice the reach. A serpentine row starts where the row
+    // above ended, so it waits for the whole row above. Every error term is
+    // then added in the same order as in a serial pass and the output is
+    // bit-identical to it. Positions within a unit count from the start of
+    // its strip's diffused columns.
+    auto processRow = [&](int unit, int y) {
+        const int g = unit % nGroups;
+        const DiffusionStrip &strip = strips[unit / nGroups];
+        const int length = strip.end - strip.begin;
+        const DiffusionGroup &group = groups[g];
+        while (availableRows.loadAcquire() <= y) {
+            QThread::yieldCurrentThread();
+        }
+        const uchar* inputRow = (passThrough ? sourceData + static_cast<qsizetype>(y) * rowLength
+                                             : ringData + (y % ringRows) * rowLength) + strip.begin * 4;
+        uchar* unitLines = errorData + unit * linesPerGroup * lineBytes;
+        void* lines[3];
+        for (int k = 0; k < kernel.rows; ++k) {
+            lines[k] = unitLines + ((y + k) % linesPerGroup) * lineBytes + kDiffusionGuard * kDiffusionLanes * kDiffusionTermBytes;
+        }
+        const QAtomicInt* above = y > 0 ? &progress[unit * progressRows + (y - 1) % progressRows] : nullptr;
+        QAtomicInt &done = progress[unit * progressRows + y % progressRows];
+        const bool reverse = serpentine && (y & 1);
+        const DiffusionBlockFunction diffuseBlock = reverse ? kernel.reverse : kernel.forward;
+        uchar levels[kDiffusionLanes][kWavefrontBlock];
+
+        const int nBlocks = (length + kWavefrontBlock - 1) / kWavefrontBlock;
+        for (int block = 0; block < nBlocks; ++block) {
+            const int x0 = (reverse ? nBlocks - 1 - block : block) * kWavefrontBlock;
+            const int x1 = std::min(length, x0 + kWavefrontBlock);
+            if (above) {
+                const int needed = serpentine ? length : std::min(length, x1 + 2 * kernel.reach);
+                while (above->loadAcquire() < needed) {
+                    QThread::yieldCurrentThread();
+                }
+            }
 
-QByteArray floydSteinbergDitherFloat(const QByteArray &cmykDataBuf, TagJobInfoRecord &jobInfo) {
-    if (cmykDataBuf.isEmpty() || jobInfo.width <= 0 || jobInfo.height <= 0 || jobInfo.level < 2 || jobInfo.level > 4) {
-        qWarning() << "Invalid input parameters";
-        return QByteArray();
-    }
+            diffuseBlock(inputRow, group, lines, strip.begin, y, x0, x1, levels[0], kWavefrontBlock);
+
+            // Pack the pixels of every plane into the output buffer, leaving
+            // out the aprons. Blocks start on a byte boundary, so each one
+            // writes whole bytes.
+            const int outputX0 = std::max(strip.begin + x0, strip.x0);
+            const int outputX1 = std::min(strip.begin + x1, strip.x1);
+            for (int lane = 0; lane < group.lanes && outputX0 < outputX1; ++lane) {
+                const int c = g * kDiffusionLanes + lane;
+                uchar* outputRow = prnPlaneLine(outputData, jobInfo, y, c);
+                PackLevels(levels[lane] + outputX0 - strip.begin - x0, outputX1 - outputX0, bitsPerPixel,
+                           outputRow + outputX0 * bitsPerPixel / 8);
+            }
 
-    // Calculate bytes per line and buffer size
-    int pixelsPerByte = (jobInfo.level == 2) ? 8 : 4;
-    jobInfo.bytePerLine = (jobInfo.width + pixelsPerByte - 1) / pixelsPerByte;
-    jobInfo.outputBuffSize = jobInfo.bytePerLine * jobInfo.height * 4;
+            done.storeRelease(reverse ? length - x0 : x1);
+        }
 
-    // Create output buffer
-    QByteArray ditheringDataBuf(jobInfo.outputBuffSize, 0);
-    uchar* outputData = reinterpret_cast<uchar*>(ditheringDataBuf.data());
+        // The line is reused by row y + linesPerGroup
+        memset(unitLines + (y % linesPerGroup) * lineBytes, 0, (length + 2 * kDiffusionGuard) * kDiffusionLanes * kDiffusionTermBytes);
+        finishedUnits[y % ringRows].fetchAndAddRelease(1);
+    };
 
-    // Create a non-const copy of the input data
-    QByteArray inputDataCopy = cmykDataBuf;
-    uchar* inputData = reinterpret_cast<uchar*>(inputDataCopy.data());
+    // One task per (row, unit), in row-major order: a task only ever waits on
+    // tasks queued before it, or on the main thread, which only waits on
+    // those, so the pool always makes progress whatever its thread count
+    QVector<int> tasks(jobInfo.height * nUnits);
+    std::iota(tasks.begin(), tasks.end(), 0);
+    QFuture<void> diffusion = QtConcurrent::map(tasks, [&](int task) {
+        processRow(task % nUnits, task / nUnits);
+    });
+
+    // Make the rows available in order. Row y takes the slots of row
+    // y - ringRows, once every unit has finished it; by then the rows above
+    // it are finished too.
+    for (int y = 0; y < jobInfo.height; ++y) {
+        QAtomicInt &finished = finishedUnits[y % ringRows];
+        if (y >= ringRows) {
+            while (finished.loadAcquire() < nUnits) {
+                QThread::yieldCurrentThread();
+            }
+        }
+        finished.storeRelaxed(0);
+        for (int unit = 0; unit < nUnits; ++unit) {
+            progress[unit * progressRows + y % progressRows].storeRelaxed(0);
+        }
+        if (!passThrough) {
+            resampler.readNextRow(ringData + (y % ringRows) * rowLength);
+        }
+        availableRows.storeRelease(y + 1);
+    }
+    diffusion.waitForFinished();
 
-    // Precompute quantization levels
-    const int maxQuantizedValue = jobInfo.level - 1;
-    const float quantizationStep = 255.0f / maxQuantizedValue;
+    return ditheringDataBuf;
+}
 
-    // Function to process a single channel
-    auto processChannel = [&](int c) {
-        QVector<float> errorBuffer(jobInfo.width * jobInfo.height, 0.0f);
+// RGB->Lab conversion of a job with its tone adjustments folded in. Brightness,
+// contrast and the per-channel curves become RGB pre-curves applied while the
+// pixels are unpacked; saturation is built into the colour transform.
+struct ToneTransform {
+    uchar curves[3][256];       // R, G, B pre-curves
+    float saturation;           // a*/b* scale for the formula conversion
+    cmsHTRANSFORM transform;    // RGB->Lab transform, nullptr without an RGB profile
+
+    ~ToneTransform() {
+        if (transform) {
+            cmsDeleteTransform(transform);
+        }
+    }
+};
+
+// Lab sampler scaling the chroma of every grid point of an abstract profile
+static cmsInt32Number saturationSampler(const cmsUInt16Number In[], cmsUInt16Number Out[], void *Cargo) {
+    const float scale = *static_cast<const float*>(Cargo);
+    cmsCIELab lab;
+    cmsLabEncoded2Float(&lab, In);
+    lab.a *= scale;
+    lab.b *= scale;
+    cmsFloat2LabEncoded(Out, &lab);
+    return TRUE;
+}
 
-        for (int y = 0; y < jobInfo.height; ++y) {
-            for (int x = 0; x < jobInfo.width; ++x) {
-                int inputIndex = (y * jobInfo.width + x) * 4 + c;
-                float oldPixel = static_cast<float>(inputData[inputIndex]) + errorBuffer[y * jobInfo.width + x];
+static cmsHPROFILE createSaturationProfile(float scale) {
+    cmsHPROFILE profile = cmsCreateProfilePlaceholder(nullptr);
+    if (!profile) {
+        return nullptr;
+    }
 
-                // Quantize the pixel
-                float newPixel = std::round(oldPixel / quantizationStep) * quantizationStep;
-                newPixel = std::clamp(newPixel, 0.0f, 255.0f);
+    cmsSetProfileVersion(profile, 4.3);
+    cmsSetDeviceClass(profile, cmsSigAbstractClass);
+    cmsSetColorSpace(profile, cmsSigLabData);
+    cmsSetPCS(profile, cmsSigLabData);
+    cmsSetHeaderRenderingIntent(profile, INTENT_PERCEPTUAL);
+
+    cmsPipeline *pipeline = cmsPipelineAlloc(nullptr, 3, 3);
+    cmsStage *clut = cmsStageAllocCLut16bit(nullptr, 33, 3, 3, nullptr);
+    if (!pipeline || !clut || !cmsStageSampleCLut16bit(clut, saturationSampler, &scale, 0)) {
+        if (clut) cmsStageFree(clut);
+        if (pipeline) cmsPipelineFree(pipeline);
+        cmsCloseProfile(profile);
+        return nullptr;
+    }
+    cmsPipelineInsertStage(pipeline, cmsAT_END, clut);
+    cmsWriteTag(profile, cmsSigAToB0Tag, pipeline);
+    cmsPipelineFree(pipeline);
 
-                // Calculate quantization error
-                float error = oldPixel - newPixel;
+    return profile;
+}
 
-                // Distribute the error to neighboring pixels
-                if (x + 1 < jobInfo.width) {
-                    errorBuffer[y * jobInfo.width + (x + 1)] += error * 7.0f / 16.0f;
-                }
-                if (y + 1 < jobInfo.height) {
-                    if (x - 1 >= 0) {
-                        errorBuffer[(y + 1) * jobInfo.width + (x - 1)] += error * 3.0f / 16.0f;
-                    }
-                    errorBuffer[(y + 1) * jobInfo.width + x] += error * 5.0f / 16.0f;
-                    if (x + 1 < jobInfo.width) {
-                        errorBuffer[(y + 1) * jobInfo.width + (x + 1)] += error * 1.0f / 16.0f;
-                    }
-                }
+// Adjusted transforms are cached under the profile and adjustment parameters, so
+// reprints and batches of a job do not rebuild them. The cache keeps the 16
+// most recently used; an evicted transform lives on until the last job using
+// it lets go of it.
+struct ToneCacheEntry {
+    QSharedPointer<const ToneTransform> tone;
+    quint64 lastUse;
+};
+
+static QSharedPointer<const ToneTransform> getToneTransform(const TagJobInfoRecord &jobInfo) {
+    static QMutex cacheMutex;
+    static QHash<QString, ToneCacheEntry> cache;
+    static quint64 useCount = 0;
+
+    const QString key = QString("%1|%2|%3|%4|%5|%6|%7")
+                            .arg(jobInfo.importRGBProfile)
+                            .arg(jobInfo.brightness)
+                            .arg(jobInfo.contrast)
+                            .arg(jobInfo.saturation)
+                            .arg(jobInfo.redCurve)
+                            .arg(jobInfo.greenCurve)
+                            .arg(jobInfo.blueCurve);
+
+    QMutexLocker locker(&cacheMutex);
+    auto cached = cache.find(key);
+    if (cached != cache.end()) {
+        cached->lastUse = ++useCount;
+        return cached->tone;
+    }
 
-                // Pack the pixel into the output buffer
-                int outputIndex = (y * jobInfo.bytePerLine * 4) + (c * jobInfo.bytePerLine) + (x / pixelsPerByte);
-                int shift = (x % pixelsPerByte) * (8 / pixelsPerByte);
-                uchar quantizedValue = static_cast<uchar>(std::round((newPixel / 255.0f * maxQuantizedValue)));
-                outputData[outputIndex] &= ~(0xFF << shift);
-                outputData[outputIndex] |= (quantizedValue << shift);
+    QSharedPointer<ToneTransform> tone(new ToneTransform);
+    BuildToneCurve(tone->curves[0], jobInfo.redCurve, jobInfo.brightness, jobInfo.contrast);
+    BuildToneCurve(tone->curves[1], jobInfo.greenCurve, jobInfo.brightness, jobInfo.contrast);
+    BuildToneCurve(tone->curves[2], jobInfo.blueCurve, jobInfo.brightness, jobInfo.contrast);
+    tone->saturation = 1.0f + std::clamp(jobInfo.saturation, -100, 100) / 100.0f;
+    tone->transform = nullptr;
+
+    cmsHPROFILE rgbProfile = jobInfo.importRGBProfile.isEmpty() ? nullptr : cmsOpenProfileFromFile(jobInfo.importRGBProfile.toLocal8Bit().constData(), "r");
+    if (rgbProfile) {
+        cmsHPROFILE labProfile = cmsCreateLab4Profile(nullptr);
+        cmsHPROFILE saturationProfile = tone->saturation != 1.0f ? createSaturationProfile(tone->saturation) : nullptr;
+
+        if (labProfile) {
+            cmsHPROFILE profiles[3] = { rgbProfile, saturationProfile, labProfile };
+            if (!saturationProfile) {
+                profiles[1] = labProfile;
             }
+            // The transform is shared between jobs, so it must not keep a pixel cache
+            tone->transform = cmsCreateMultiprofileTransform(profiles,
+                                                             saturationProfile ? 3 : 2,
+                                                             TYPE_RGB_8,
+                                                             TYPE_Lab_FLT,
+                                                             INTENT_PERCEPTUAL,
+                                                             cmsFLAGS_NOCACHE);
+            if (!tone->transform) {
+                qWarning() << "Failed to create color transform";
+            }
+            cmsCloseProfile(labProfile);
+        } else {
+            qWarning() << "Failed to create LAB profile";
         }
-    };
 
-    // Use a thread pool for parallel channel processing
-    QVector<int> channels = {0, 1, 2, 3}; // Channels: C, M, Y, K
-    QtConcurrent::blockingMap(channels, processChannel);
+        if (saturationProfile) {
+            cmsCloseProfile(saturationProfile);
+        }
+        cmsCloseProfile(rgbProfile);
+    }
+
+    // Keep the cache bounded: drop the least recently used entry
+    if (cache.size() >= 16) {
+        auto oldest = cache.begin();
+        for (auto entry = cache.begin(); entry != cache.end(); ++entry) {
+            if (entry->lastUse < oldest->lastUse) {
+                oldest = entry;
+            }
+        }
+        cache.erase(oldest);
+    }
+    cache.insert(key, { tone, ++useCount });
 
-    return ditheringDataBuf;
+    return tone;
 }
 
-    QByteArray convertRGBtoLAB(const QImage &image,  TagJobInfoRecord &jobInfo) {
+QByteArray convertRGBtoLAB(const QImage &image,  TagJobInfoRecord &jobInfo) {
     if (image.isNull()) {
         qWarning() << "Invalid input image";
         return QByteArray();
@@ -403,8 +678,12 @@ QByteArray floydSteinbergDitherFloat(const QByteArray &cmykDataBuf, TagJobInfoRe
         }
     }
 
-    cmsHPROFILE rgbProfile = cmsOpenProfileFromFile(jobInfo.importRGBProfile.toLocal8Bit().constData(), "r");
-    if (jobInfo.importRGBProfile.isEmpty() || !rgbProfile) {
+    const QSharedPointer<const ToneTransform> tone = getToneTransform(jobInfo);
+    const uchar *redCurve = tone->curves[0];
+    const uchar *greenCurve = tone->curves[1];
+    const uchar *blueCurve = tone->curves[2];
+
+    if (!tone->transform) {
         const int width = convertedImage.width();
         const int height = convertedImage.height();
         const int totalPixels = width * height;
@@ -413,14 +692,15 @@ QByteArray floydSteinbergDitherFloat(const QByteArray &cmykDataBuf, TagJobInfoRe
         float* labData = reinterpret_cast<float*>(labBuffer.data());
 
         const quint32* pixels = reinterpret_cast<const quint32*>(convertedImage.constBits());
+        const float saturation = tone->saturation;
 
         for (int i = 0; i < totalPixels; ++i) {
             const quint32 pixel = pixels[i];
 
-            // Extract RGB components
-            float r3 = qRed(pixel) / 255.0f;
-            float g3 = qGreen(pixel) / 255.0f;
-            float b3 = qBlue(pixel) / 255.0f;
+            // Extract RGB components through the tone curves
+            float r3 = redCurve[qRed(pixel)] / 255.0f;
+            float g3 = greenCurve[qGreen(pixel)] / 255.0f;
+            float b3 = blueCurve[qBlue(pixel)] / 255.0f;
 
             // Convert sRGB to linear RGB
             auto srgbToLinear = [](float value) {
@@ -449,36 +729,14 @@ QByteArray floydSteinbergDitherFloat(const QByteArray &cmykDataBuf, TagJobInfoRe
             float fy = xyzToLab(y / yn);
             float fz = xyzToLab(z / zn);
 
-            labData[i * 3] = std::max(0.0f, 116.0f * fy - 16.0f); // L*
-            labData[i * 3 + 1] = 500.0f * (fx - fy);              // a*
-            labData[i * 3 + 2] = 200.0f * (fy - fz);              // b*
+            labData[i * 3] = std::max(0.0f, 116.0f * fy - 16.0f);       // L*
+            labData[i * 3 + 1] = 500.0f * (fx - fy) * saturation;      // a*
+            labData[i * 3 + 2] = 200.0f * (fy - fz) * saturation;      // b*
         }
 
         return labBuffer;
     }
 
-    cmsHPROFILE labProfile = cmsCreateLab4Profile(nullptr);
-    if (!labProfile) {
-        cmsCloseProfile(rgbProfile);
-        qWarning() << "Failed to create LAB profile";
-        return QByteArray();
-    }
-
-    // Create color transformation
-    cmsHTRANSFORM transform = cmsCreateTransform(rgbProfile,
-                                                 TYPE_RGB_8,
-                                                 labProfile,
-                                                 TYPE_Lab_FLT,
-                                                 INTENT_PERCEPTUAL,
-                                                 0);
-    cmsCloseProfile(rgbProfile);
-    cmsCloseProfile(labProfile);
-
-    if (!transform) {
-        qWarning() << "Failed to create color transform";
-        return QByteArray();
-    }
-
     // Prepare input and output buffers
     const int width = convertedImage.width();
     const int height = convertedImage.height();
@@ -487,22 +745,19 @@ QByteArray floydSteinbergDitherFloat(const QByteArray &cmykDataBuf, TagJobInfoRe
     QByteArray rgbData(totalPixels * 3, Qt::Uninitialized); // 3 channels (R, G, B)
     QByteArray labBuffer(totalPixels * 3 * sizeof(float), Qt::Uninitialized); // 3 channels (L, a, b)
 
-    // Extract RGB components from ARGB32 pixels
+    // Extract RGB components from ARGB32 pixels through the tone curves
     const quint32* pixels = reinterpret_cast<const quint32*>(convertedImage.constBits());
     uchar* rgbBuffer = reinterpret_cast<uchar*>(rgbData.data());
 
     for (int i = 0; i < totalPixels; ++i) {
         const quint32 pixel = pixels[i];
-        rgbBuffer[i * 3] = qRed(pixel);    // Red component
-        rgbBuffer[i * 3 + 1] = qGreen(pixel); // Green component
-        rgbBuffer[i * 3 + 2] = qBlue(pixel);  // Blue component
+        rgbBuffer[i * 3] = redCurve[qRed(pixel)];       // Red component
+        rgbBuffer[i * 3 + 1] = greenCurve[qGreen(pixel)]; // Green component
+        rgbBuffer[i * 3 + 2] = blueCurve[qBlue(pixel)];   // Blue component
     }
 
-    // Transform to LAB
-    cmsDoTransform(transform, rgbBuffer, labBuffer.data(), totalPixels);
-
-    // Clean up
-    cmsDeleteTransform(transform);
+    // Transform to LAB (the cached transform is owned by the cache)
+    cmsDoTransform(tone->transform, rgbBuffer, labBuffer.data(), totalPixels);
 
     return labBuffer;
 }
@@ -619,6 +874,154 @@ QByteArray convertLABtoCMYK(const QByteArray &labDataBuf, TagJobInfoRecord &jobI
     return cmykDataBuf;
 }
 
+// Relative per-pixel costs of the stages, measured against one LittleCMS
+// transform lookup. The formula fallbacks (pow/cbrt per channel) cost more.
+static const double kIccTransformCost = 1.0;
+static const double kRgbToLabFormulaCost = 2.5;
+static const double kLabToCmykFormulaCost = 2.0;
+static const double kLabBufferCost = 0.25;          // 12-byte float Lab pixel, written and read back
+static const double kResampleSourceCost = 0.05;     // Reading a source pixel
+static const double kResampleOutputCost = 0.15;     // Per output pixel and tap pair
+
+StagePlan planStageOrder(const TagJobInfoRecord &jobInfo) {
+    const double sourcePixels = static_cast<double>(jobInfo.width) * jobInfo.height;
+    const double outputPixels = std::round(jobInfo.width * jobInfo.xTimes) * std::round(jobInfo.height * jobInfo.yTimes);
+
+    // Conversion cost per pixel: 3 channels to Lab, Lab to 4 channels
+    const double rgbToLab = jobInfo.importRGBProfile.isEmpty() ? kRgbToLabFormulaCost : kIccTransformCost;
+    const double labToCmyk = jobInfo.importCMYKProfile.isEmpty() ? kLabToCmykFormulaCost : kIccTransformCost;
+    const double convertCost = rgbToLab * 3.0 / 4.0 + labToCmyk + kLabBufferCost;
+
+    // Both orders resize 4-byte pixels (ARGB or CMYK) with the same filter
+    int taps = 1;
+    if (jobInfo.resampleFilter == ResampleMitchell) {
+        taps = 2;
+    } else if (jobInfo.resampleFilter == ResampleLanczos3) {
+        taps = 3;
+    }
+    const double resizeCost = sourcePixels * kResampleSourceCost + outputPixels * kResampleOutputCost * taps;
+
+    StagePlan plan;
+    plan.convertThenResizeCost = sourcePixels * convertCost + resizeCost;
+    plan.resizeThenConvertCost = resizeCost + outputPixels * convertCost;
+    plan.order = plan.resizeThenConvertCost < plan.convertThenResizeCost ? ResizeThenConvert : ConvertThenResize;
+
+    plan.summary = QString("Stage order = %1 (scale %2x%3, cost %4 vs %5 Mpx-ops)")
+                       .arg(plan.order == ResizeThenConvert ? "resize RGB, then convert" : "convert, then resize CMYK")
+                       .arg(jobInfo.xTimes, 0, 'f', 3)
+                       .arg(jobInfo.yTimes, 0, 'f', 3)
+                       .arg(std::min(plan.convertThenResizeCost, plan.resizeThenConvertCost) / 1e6, 0, 'f', 1)
+                       .arg(std::max(plan.convertThenResizeCost, plan.resizeThenConvertCost) / 1e6, 0, 'f', 1);
+    return plan;
+}
+
+QImage resizeRGBImage(const QImage &image, TagJobInfoRecord &jobInfo) {
+    if (image.isNull() || jobInfo.xTimes <= 0 || jobInfo.yTimes <= 0) {
+        qWarning() << "Invalid input image";
+        return QImage();
+    }
+
+    // 32-bit pixels: the resampler treats them like CMYK, one byte per channel
+    QImage convertedImage = image.convertToFormat(QImage::Format_ARGB32);
+    const int width = convertedImage.width();
+    const int height = convertedImage.height();
+    QByteArray pixelBuf(static_cast<qsizetype>(width) * height * 4, Qt::Uninitialized);
+    for (int y = 0; y < height; ++y) {
+        memcpy(pixelBuf.data() + static_cast<qsizetype>(y) * width * 4, convertedImage.constScanLine(y), static_cast<size_t>(width) * 4);
+    }
+
+    const int newWidth = static_cast<int>(std::round(width * jobInfo.xTimes));
+    const int newHeight = static_cast<int>(std::round(height * jobInfo.yTimes));
+    QByteArray resizedBuf = ResampleCMYK(pixelBuf, width, height, newWidth, newHeight,
+                                         static_cast<ResampleFilter>(jobInfo.resampleFilter));
+    if (resizedBuf.isEmpty()) {
+        return QImage();
+    }
+
+    QImage resizedImage(newWidth, newHeight, QImage::Format_ARGB32);
+    for (int y = 0; y < newHeight; ++y) {
+        memcpy(resizedImage.scanLine(y), resizedBuf.constData() + static_cast<qsizetype>(y) * newWidth * 4, static_cast<size_t>(newWidth) * 4);
+    }
+
+    // The image is now at output resolution
+    jobInfo.width = newWidth;
+    jobInfo.height = newHeight;
+    jobInfo.xTimes = 1.0f;
+    jobInfo.yTimes = 1.0f;
+
+    return resizedImage;
+}
+
+QImage loadJobImage(const QString &path, const QSize &outputSize) {
+    QImageReader reader(path);
+    const QSize fullSize = reader.size();
+
+    if (fullSize.isValid() && outputSize.isValid() && reader.supportsOption(QImageIOHandler::ScaledSize)) {
+        // Cheap decode scales: 1/8, 1/4, 1/2. The sizes are rounded up the way
+        // libjpeg does, so the decoder needs no extra resampling pass.
+        for (int denominator = 8; denominator >= 2; denominator /= 2) {
+            QSize decodeSize((fullSize.width() + denominator - 1) / denominator,
+                             (fullSize.height() + denominator - 1) / denominator);
+            if (decodeSize.width() >= outputSize.width() && decodeSize.height() >= outputSize.height()) {
+                reader.setScaledSize(decodeSize);
+                break;
+            }
+        }
+    }
+
+    QImage image = reader.read();
+    if (image.isNull()) {
+        qWarning() << "Failed to load image:" << path << reader.errorString();
+        return QImage();
+    }
+
+    // Keep the physical size of a scaled decode
+    if (fullSize.isValid() && image.size() != fullSize) {
+        image.setDotsPerMeterX(qRound(static_cast<double>(image.dotsPerMeterX()) * image.width() / fullSize.width()));
+        image.setDotsPerMeterY(qRound(static_cast<double>(image.dotsPerMeterY()) * image.height() / fullSize.height()));
+    }
+
+    return image;
+}
+
+QImage loadPreviewImage(const QString &path, const QSize &boundingSize, QSize *fullSize) {
+    QImageReader reader(path);
+    const QSize size = reader.size();
+    if (fullSize) {
+        *fullSize = size;
+    }
+
+    // JPEG previews decode in the DCT domain; other formats are scaled after decoding
+    if (size.isValid() && boundingSize.isValid()) {
+        reader.setScaledSize(size.scaled(boundingSize, Qt::KeepAspectRatio));
+    }
+
+    QImage image = reader.read();
+    if (image.isNull()) {
+        qWarning() << "Failed to load image:" << path << reader.errorString();
+        return QImage();
+    }
+
+    // The reader could not tell the size up front
+    if (!size.isValid()) {
+        if (fullSize) {
+            *fullSize = image.size();
+        }
+        if (boundingSize.isValid()) {
+            image = image.scaled(boundingSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        }
+    }
+
+    return image;
+}
+
+RowResampler createCMYKResampler(const QByteArray &cmykDataBuf, const TagJobInfoRecord &jobInfo) {
+    int newWidth = static_cast<int>(std::round(jobInfo.width * jobInfo.xTimes));
+    int newHeight = static_cast<int>(std::round(jobInfo.height * jobInfo.yTimes));
+    return RowResampler(cmykDataBuf, jobInfo.width, jobInfo.height, newWidth, newHeight,
+                        static_cast<ResampleFilter>(jobInfo.resampleFilter));
+}
+
 QByteArray resizeCMYKData(const QByteArray &cmykDataBuf,  TagJobInfoRecord &jobInfo) {
     if (cmykDataBuf.isEmpty() || jobInfo.width <= 0 || jobInfo.height <= 0 || jobInfo.xTimes <= 0 || jobInfo.yTimes <= 0) {
         qWarning() << "Invalid input parameters";
@@ -634,126 +1037,164 @@ QByteArray resizeCMYKData(const QByteArray &cmykDataBuf,  TagJobInfoRecord &jobI
         return QByteArray();
     }
 
-    // Create output buffer
-    QByteArray resizedCmykDataBuf(newWidth * newHeight * 4, Qt::Uninitialized);
-
-    // Get pointers to input and output data
-    const uchar* inputData = reinterpret_cast<const uchar*>(cmykDataBuf.constData());
-    uchar* outputData = reinterpret_cast<uchar*>(resizedCmykDataBuf.data());
-
-    // Function to process a single row
-    auto processRow = [&](int y) {
-        for (int x = 0; x < newWidth; ++x) {
-            // Calculate corresponding coordinates in the original image
-            float srcX = x / jobInfo.xTimes;
-            float srcY = y / jobInfo.yTimes;
-
-            // Get the four neighboring pixels
-            int x1 = static_cast<int>(srcX);
-            int y1 = static_cast<int>(srcY);
-            int x2 = std::min(x1 + 1, jobInfo.width - 1);
-            int y2 = std::min(y1 + 1, jobInfo.height - 1);
-
-            // Calculate weights for interpolation
-            float xWeight = srcX - x1;
-            float yWeight = srcY - y1;
-
-            // Process each channel (C, M, Y, K)
-            for (int c = 0; c < 4; ++c) {
-                // Perform bilinear interpolation
-                float v11 = inputData[(y1 * jobInfo.width + x1) * 4 + c];
-                float v21 = inputData[(y1 * jobInfo.width + x2) * 4 + c];
-                float v12 = inputData[(y2 * jobInfo.width + x1) * 4 + c];
-                float v22 = inputData[(y2 * jobInfo.width + x2) * 4 + c];
-
-                float v1 = v11 * (1 - xWeight) + v21 * xWeight;
-                float v2 = v12 * (1 - xWeight) + v22 * xWeight;
-                float value = v1 * (1 - yWeight) + v2 * yWeight;
-
-                // Clamp the value to the valid range [0, 255]
-                outputData[(y * newWidth + x) * 4 + c] = static_cast<uchar>(std::clamp(value, 0.0f, 255.0f));
-            }
-        }
-    };
+    // Separable two-pass resize with precomputed coefficient tables
+    QByteArray resizedCmykDataBuf = ResampleCMYK(cmykDataBuf, jobInfo.width, jobInfo.height, newWidth, newHeight,
+                                                 static_cast<ResampleFilter>(jobInfo.resampleFilter));
 
-    // Use a thread pool for parallel row processing
-    QThreadPool pool;
-    pool.setMaxThreadCount(QThread::idealThreadCount()); // Use all available cores
-
-    QVector<int> rows(newHeight);
-    for (int y = 0; y < newHeight; ++y) {
-        rows[y] = y;
-    }
-
-    QtConcurrent::blockingMap(rows, processRow);
+    // The dithering stages work on the resized image
+    jobInfo.width = newWidth;
+    jobInfo.height = newHeight;
 
     return resizedCmykDataBuf;
 }
 
 
 QByteArray orderedDither(const QByteArray &cmykDataBuf, TagJobInfoRecord &jobInfo) {
-    if (cmykDataBuf.isEmpty() || jobInfo.width <= 0 || jobInfo.height <= 0 || jobInfo.level < 2 || jobInfo.level > 4) {
+    if (cmykDataBuf.isEmpty() || jobInfo.width <= 0 || jobInfo.height <= 0) {
+        qWarning() << "Invalid input parameters";
+        return QByteArray();
+    }
+
+    // Same-size resampler: rows come straight from the input buffer
+    RowResampler rows(cmykDataBuf, jobInfo.width, jobInfo.height, jobInfo.width, jobInfo.height, ResampleBilinear);
+    return orderedDither(rows, jobInfo);
+}
+
+QByteArray orderedDither(RowResampler &resampler, TagJobInfoRecord &jobInfo) {
+    if (!resampler.isValid() || jobInfo.level < 2 || jobInfo.level > kMaxOutputLevels) {
         qWarning() << "Invalid input parameters";
         return QByteArray();
     }
 
-    // Calculate bytes per line for each color
-    int pixelsPerByte = (jobInfo.level == 2) ? 8 : 4;
-    jobInfo.bytePerLine = (jobInfo.width + pixelsPerByte - 1) / pixelsPerByte;
-    jobInfo.outputBuffSize = jobInfo.bytePerLine * jobInfo.height * 4;
+    // The output has the size of the resampled image
+    jobInfo.width = resampler.width();
+    jobInfo.height = resampler.height();
 
-    // Create output buffer
-    QByteArray ditheringDataBuf(jobInfo.outputBuffSize, 0);
+    // Output buffer in the PRN layout
+    const int bitsPerPixel = BitsPerPixel(jobInfo.level);
+    const int nColors = jobInfo.inkPlanes.size();
+    QByteArray ditheringDataBuf = createPrnBuffer(jobInfo, bitsPerPixel);
     uchar* outputData = reinterpret_cast<uchar*>(ditheringDataBuf.data());
 
-    // Use an 8x8 Bayer threshold map for better quality
-    const int bayerMap[8][8] = {
-        {  0, 32,  8, 40,  2, 34, 10, 42 },
-        { 48, 16, 56, 24, 50, 18, 58, 26 },
-        { 12, 44,  4, 36, 14, 46,  6, 38 },
-        { 60, 28, 52, 20, 62, 30, 54, 22 },
-        {  3, 35, 11, 43,  1, 33,  9, 41 },
-        { 51, 19, 59, 27, 49, 17, 57, 25 },
-        { 15, 47,  7, 39, 13, 45,  5, 37 },
-        { 63, 31, 55, 23, 61, 29, 53, 21 }
-    };
+    const int rowLength = jobInfo.width * 4;
+
+    // Threshold tile of every plane and its origin. FM planes share one tile at
+    // different offsets, AM planes use the tile of their channel's angle.
+    const int method = jobInfo.dithering / 3;
+    QVector<ThresholdTile> tiles;
+    QVector<int> tileOf(nColors);
+    QVector<int> offsetX(nColors);
+    QVector<int> offsetY(nColors);
+    for (int c = 0; c < nColors; ++c) {
+        ThresholdTile tile;
+        PlaneScreen(method, c, jobInfo.inkPlanes[c].source, jobInfo.screenLpi, jobInfo.xResolution,
+                    tile, offsetX[c], offsetY[c]);
+        tileOf[c] = 0;
+        while (tileOf[c] < tiles.size() && tiles[tileOf[c]].thresholds.constData() != tile.thresholds.constData()) {
+            ++tileOf[c];
+        }
+        if (tileOf[c] == tiles.size()) {
+            tiles.append(tile);
+        }
+    }
 
-    // Normalize the threshold map to the range [0, 255]
-    const float bayerScale = 255.0f / 64.0f;
-    const int maxQuantizedValue = jobInfo.level - 1;
-    const float quantizationStep = 255.0f / maxQuantizedValue;
+    // Rows are screened 32 pixels at a time. The tile rows are repeated out to
+    // the padded width plus one tile, so the thresholds of a plane row are one
+    // contiguous run whatever the plane's offset.
+    const int paddedWidth = (jobInfo.width + 31) / 32 * 32;
+    QVector<QByteArray> tiledRows(tiles.size());
+    QVector<int> tiledStride(tiles.size());
+    for (int t = 0; t < tiles.size(); ++t) {
+        const ThresholdTile &tile = tiles[t];
+        tiledStride[t] = paddedWidth + tile.width;
+        tiledRows[t] = QByteArray(tile.height * tiledStride[t], Qt::Uninitialized);
+        for (int ty = 0; ty < tile.height; ++ty) {
+            uchar* tiledRow = reinterpret_cast<uchar*>(tiledRows[t].data()) + ty * tiledStride[t];
+            const uchar* tileRow = tile.thresholds.constData() + ty * tile.width;
+            for (int i = 0; i < tiledStride[t]; i += tile.width) {
+                memcpy(tiledRow + i, tileRow, std::min(tile.width, tiledStride[t] - i));
+            }
+        }
+    }
 
-    // Iterate over each pixel
-    for (int y = 0; y < jobInfo.height; ++y) {
-        for (int x = 0; x < jobInfo.width; ++x) {
-            // Process each channel (C, M, Y, K)
-            for (int c = 0; c < 4; ++c) {
-                int inputIndex = (y * jobInfo.width + x) * 4 + c;
-                float oldPixel = static_cast<float>(outputData[inputIndex]);
-
-                // Apply the Bayer threshold
-                int threshold = bayerMap[y % 8][x % 8];
-                float normalizedThreshold = threshold * bayerScale;
-
-                // Quantize the pixel based on the level
-                float newPixel = std::round(oldPixel / quantizationStep) * quantizationStep;
-                newPixel = std::clamp(newPixel, 0.0f, 255.0f);
-
-                // Pack the pixel into the output buffer
-                int outputIndex = (y * jobInfo.bytePerLine * 4) + (c * jobInfo.bytePerLine) + (x / pixelsPerByte);
-                int shift = (x % pixelsPerByte) * (8 / pixelsPerByte);
-                uchar quantizedValue = static_cast<uchar>(std::round((newPixel / 255.0f * maxQuantizedValue)));
-
-                outputData[outputIndex] &= ~(0xFF << shift);
-                outputData[outputIndex] |= (quantizedValue << shift);
+    // The tone of a pixel (through the plane's ink table) splits into a level,
+    // the largest drop not above it, and a remainder, its position towards the
+    // next drop in 1/255 (0..254). The pixel takes the next level up where the
+    // remainder is above the threshold. For evenly spaced drops this is
+    // tone * (levels - 1) = level * 255 + remainder.
+    QVector<uchar> levelTables(nColors * 256);
+    QVector<uchar> remainderTables(nColors * 256);
+    for (int c = 0; c < nColors; ++c) {
+        const InkPlane &plane = jobInfo.inkPlanes[c];
+        for (int v = 0; v < 256; ++v) {
+            const float tone = plane.lut[v];
+            int level = 0;
+            while (level + 1 < plane.levels && plane.drops[level + 1] <= tone) {
+                ++level;
+            }
+            float remainder = 0.0f;
+            if (level + 1 < plane.levels) {
+                remainder = (tone - plane.drops[level]) * 255.0f / (plane.drops[level + 1] - plane.drops[level]);
+            }
+            levelTables[c * 256 + v] = static_cast<uchar>(level);
+            remainderTables[c * 256 + v] = static_cast<uchar>(std::min(std::round(remainder), 254.0f));
+        }
+    }
+
+    // Function to screen one resampled row into whole output bytes. 'scratch'
+    // holds the level, remainder and packed lines of the calling band.
+    auto processRow = [&](int y, const uchar* inputRow, uchar* scratch) {
+        uchar* levelLine = scratch;
+        uchar* remainderLine = scratch + paddedWidth;
+        uchar* packedLine = scratch + 2 * paddedWidth;
+
+        // Process each ink plane (C, M, Y, K, light inks)
+        for (int c = 0; c < nColors; ++c) {
+            const InkPlane &plane = jobInfo.inkPlanes[c];
+            const uchar* levelTable = levelTables.constData() + c * 256;
+            const uchar* remainderTable = remainderTables.constData() + c * 256;
+            for (int x = 0; x < jobInfo.width; ++x) {
+                const uchar tone = inputRow[x * 4 + plane.source];
+                levelLine[x] = levelTable[tone];
+                remainderLine[x] = remainderTable[tone];
             }
+
+            const int t = tileOf[c];
+            const uchar* thresholds = reinterpret_cast<const uchar*>(tiledRows[t].constData())
+                                    + ((y + offsetY[c]) % tiles[t].height) * tiledStride[t] + offsetX[c] % tiles[t].width;
+            ScreenRow(levelLine, remainderLine, thresholds, paddedWidth, bitsPerPixel, packedLine);
+            memcpy(prnPlaneLine(outputData, jobInfo, y, c), packedLine, jobInfo.bytePerLine);
         }
+    };
+
+    // Rows are screened independently: every fixed band resamples its rows
+    // into the line of its own resampler (or reads them in place) and screens
+    // each one right away
+    const int bandCount = (jobInfo.height + kParallelBandRows - 1) / kParallelBandRows;
+    QVector<int> bands(bandCount);
+    for (int b = 0; b < bandCount; ++b) {
+        bands[b] = b;
     }
+    QtConcurrent::blockingMap(bands, [&](int b) {
+        const int y0 = b * kParallelBandRows;
+        const int y1 = std::min(jobInfo.height, y0 + kParallelBandRows);
+        RowResampler bandResampler = resampler;
+        QByteArray scratch(3 * paddedWidth, 0);
+        for (int y = y0; y < y1; ++y) {
+            processRow(y, bandResampler.row(y), reinterpret_cast<uchar*>(scratch.data()));
+        }
+    });
 
     return ditheringDataBuf;
 }
 
 int CreatePrnFile(const QString &prnFilePath, const QByteArray &outDataBuf, const TagJobInfoRecord &jobInfo) {
+    // The dither stages produce the file as it is written
+    if (outDataBuf.size() != jobInfo.outputBuffSize || outDataBuf.size() < static_cast<int>(sizeof(tagHeadRecord_1))) {
+        qWarning() << "Invalid dithered data for .prn file:" << prnFilePath;
+        return -1;
+    }
+
     // Open the file for writing (truncate if it exists)
     QFile prnFile(prnFilePath);
     if (!prnFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
@@ -761,57 +1202,11 @@ int CreatePrnFile(const QString &prnFilePath, const QByteArray &outDataBuf, cons
         return -1;
     }
 
-    // Create a data stream for writing to the file
-    QDataStream out(&prnFile);
-    out.setByteOrder(QDataStream::LittleEndian); // Ensure little-endian byte order
-
-    // Populate the header structure
-    tagHeadRecord_1 header;
-    header.nSignature = 0x5555; // Signature
-    header.nXDPI = int(jobInfo.xImageResolution + 0.5);
-    header.nYDPI = int(jobInfo.yImageResolution + 0.5);
-    header.nBytesPerLine = (jobInfo.bytePerLine + 3) / 4 * 4;
-    header.nHeight = jobInfo.height;
-    header.nWidth = jobInfo.width;
-    header.nPaperWidth = 0;     // Not used
-    header.nColors = 4;         // CMYK
-    header.nBits = (jobInfo.nLevel + 1) / 2;
-    header.nReserved[0] = 0;    // Pass Number
-    header.nReserved[1] = 0;    // vsdMode
-    header.nReserved[2] = 0;    // Reserved
-
-    // Write the header to the file
-    out.writeRawData(reinterpret_cast<const char*>(&header), sizeof(header));
-
-    // Calculate padding size (if needed)
-    int paddingSize = (4 - (jobInfo.bytePerLine % 4)) % 4; // Ensure bytePerLine is a multiple of 4
-
-    // Write the data in YMCK order
-    const uchar* inputData = reinterpret_cast<const uchar*>(outDataBuf.constData());
-    for (int y = 0; y < jobInfo.height; ++y) {
-        // Write K (Black) data
-        out.writeRawData(reinterpret_cast<const char*>(inputData + (y * jobInfo.bytePerLine * 4) + 3 * jobInfo.bytePerLine), jobInfo.bytePerLine);
-        if (paddingSize > 0) {
-            out.writeRawData("\0\0\0", paddingSize); // Add padding
-        }
-
-        // Write C (Cyan) data
-        out.writeRawData(reinterpret_cast<const char*>(inputData + (y * jobInfo.bytePerLine * 4) + 0 * jobInfo.bytePerLine), jobInfo.bytePerLine);
-        if (paddingSize > 0) {
-            out.writeRawData("\0\0\0", paddingSize); // Add padding
-        }
-
-        // Write M (Magenta) data
-        out.writeRawData(reinterpret_cast<const char*>(inputData + (y * jobInfo.bytePerLine * 4) + 1 * jobInfo.bytePerLine), jobInfo.bytePerLine);
-        if (paddingSize > 0) {
-            out.writeRawData("\0\0\0", paddingSize); // Add padding
-        }
-
-        // Write Y (Yellow) data
-        out.writeRawData(reinterpret_cast<const char*>(inputData + (y * jobInfo.bytePerLine * 4) + 2 * jobInfo.bytePerLine), jobInfo.bytePerLine);
-        if (paddingSize > 0) {
-            out.writeRawData("\0\0\0", paddingSize); // Add padding
-        }
+    // Header and all rows in one contiguous write
+    if (prnFile.write(outDataBuf) != outDataBuf.size()) {
+        qWarning() << "Failed to write .prn file:" << prnFilePath << prnFile.errorString();
+        prnFile.close();
+        return -1;
     }
 
     // Close the file
@@ -0,0 +1,627 @@
+#include "Resampler.h"
+#include <QDebug>
+#include <QtConcurrent/QtConcurrentMap>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define RIP_AVX2_KERNELS 1
+#endif
+
+static const float kPi = 3.14159265358979f;
+
+// Filter kernels and their support radius
+static float filterRadius(ResampleFilter filter)
+{
+    switch (filter) {
+    case ResampleMitchell:
+        return 2.0f;
+    case ResampleLanczos3:
+        return 3.0f;
+    default:
+        return 1.0f;
+    }
+}
+
+static float filterKernel(ResampleFilter filter, float t)
+{
+    t = std::fabs(t);
+    switch (filter) {
+    case ResampleMitchell: {
+        // Mitchell-Netravali with B = C = 1/3
+        const float B = 1.0f / 3.0f;
+        const float C = 1.0f / 3.0f;
+        if (t < 1.0f) {
+            return ((12 - 9 * B - 6 * C) * t * t * t + (-18 + 12 * B + 6 * C) * t * t + (6 - 2 * B)) / 6.0f;
+        }
+        if (t < 2.0f) {
+            return ((-B - 6 * C) * t * t * t + (6 * B + 30 * C) * t * t + (-12 * B - 48 * C) * t + (8 * B + 24 * C)) / 6.0f;
+        }
+        return 0.0f;
+    }
+    case ResampleLanczos3:
+        if (t < 1e-6f) {
+            return 1.0f;
+        }
+        if (t < 3.0f) {
+            const float x = kPi * t;
+            return 3.0f * std::sin(x) * std::sin(x / 3.0f) / (x * x);
+        }
+        return 0.0f;
+    default:
+        return t < 1.0f ? 1.0f - t : 0.0f;
+    }
+}
+
+ResampleCoefficients BuildResampleCoefficients(int srcSize, int dstSize, ResampleFilter filter)
+{
+    ResampleCoefficients coeffs;
+    const float scale = static_cast<float>(dstSize) / srcSize;
+
+    // Stretch the kernel when downscaling so it covers all source samples
+    const float filterScale = std::min(scale, 1.0f);
+    const float support = filterRadius(filter) / filterScale;
+
+    coeffs.taps = std::min(srcSize, std::max(1, static_cast<int>(std::ceil(2.0f * support))));
+    coeffs.start.resize(dstSize);
+    coeffs.weights = QVector<float>(dstSize * coeffs.taps, 0.0f);
+
+    for (int i = 0; i < dstSize; ++i) {
+        // Sample centres are aligned: output pixel i covers source [i, i + 1) / scale
+        const float center = (i + 0.5f) / scale - 0.5f;
+        const int first = static_cast<int>(std::floor(center - support)) + 1;
+        const int last = static_cast<int>(std::ceil(center + support)) - 1;
+
+        // Keep the window inside the image; taps outside the edges fold onto them
+        int start = std::clamp(first, 0, srcSize - coeffs.taps);
+        float* weights = coeffs.weights.data() + i * coeffs.taps;
+        float sum = 0.0f;
+
+        for (int j = first; j <= last; ++j) {
+            float w = filterKernel(filter, (j - center) * filterScale);
+            if (w == 0.0f) {
+                continue;
+            }
+            int k = std::clamp(j, 0, srcSize - 1) - start;
+            k = std::clamp(k, 0, coeffs.taps - 1);
+            weights[k] += w;
+            sum += w;
+        }
+
+        // Normalize so flat areas stay flat
+        if (sum != 0.0f) {
+            for (int k = 0; k < coeffs.taps; ++k) {
+                weights[k] /= sum;
+            }
+        } else {
+            weights[std::clamp(static_cast<int>(std::round(center)), 0, srcSize - 1) - start] = 1.0f;
+        }
+        coeffs.start[i] = start;
+    }
+
+    return coeffs;
+}
+
+ResamplePlan BuildResamplePlan(int srcWidth, int srcHeight, int dstWidth, int dstHeight, ResampleFilter filter)
+{
+    ResamplePlan plan;
+    plan.srcWidth = srcWidth;
+    plan.srcHeight = srcHeight;
+    plan.dstWidth = dstWidth;
+    plan.dstHeight = dstHeight;
+    plan.x = BuildResampleCoefficients(srcWidth, dstWidth, filter);
+    plan.y = BuildResampleCoefficients(srcHeight, dstHeight, filter);
+    return plan;
+}
+
+void ResampleRowHorizontal(const uchar* src, float* dst, const ResampleCoefficients& coeffs, int dstWidth)
+{
+    const int taps = coeffs.taps;
+    const int* start = coeffs.start.constData();
+    const float* weights = coeffs.weights.constData();
+
+    for (int x = 0; x < dstWidth; ++x) {
+        const uchar* pixel = src + start[x] * 4;
+        const float* w = weights + x * taps;
+
+        // All 4 channels of a pixel accumulate together (one 4-wide vector)
+        float c = 0.0f, m = 0.0f, y = 0.0f, k = 0.0f;
+        for (int t = 0; t < taps; ++t) {
+            c += w[t] * pixel[t * 4];
+            m += w[t] * pixel[t * 4 + 1];
+            y += w[t] * pixel[t * 4 + 2];
+            k += w[t] * pixel[t * 4 + 3];
+        }
+
+        dst[x * 4] = c;
+        dst[x * 4 + 1] = m;
+        dst[x * 4 + 2] = y;
+        dst[x * 4 + 3] = k;
+    }
+}
+
+BilinearTable BuildBilinearTable(int srcSize, int dstSize)
+{
+    BilinearTable table;
+    table.index0.resize(dstSize);
+    table.index1.resize(dstSize);
+    table.fraction.resize(dstSize);
+    table.weights.resize(dstSize);
+
+    for (int i = 0; i < dstSize; ++i) {
+        // Aligned centres in 1/256 source pixels: ((i + 0.5) * src / dst - 0.5) * 256
+        qint64 position = ((2 * static_cast<qint64>(i) + 1) * srcSize * 128) / dstSize - 128;
+        position = std::clamp<qint64>(position, 0, static_cast<qint64>(srcSize - 1) * 256);
+
+        const int index = static_cast<int>(position >> 8);
+        const int fraction = static_cast<int>(position & 255);
+        table.index0[i] = index;
+        table.index1[i] = std::min(index + 1, srcSize - 1);
+        table.fraction[i] = fraction;
+        table.weights[i] = (static_cast<quint32>(fraction) << 16) | static_cast<quint32>(256 - fraction);
+    }
+
+    return table;
+}
+
+void BilinearRowFixedScalar(const uchar* src, qint32* dst, const BilinearTable& table, int x0, int x1)
+{
+    for (int x = x0; x < x1; ++x) {
+        const uchar* p0 = src + table.index0[x] * 4;
+        const uchar* p1 = src + table.index1[x] * 4;
+        const int f = table.fraction[x];
+        for (int c = 0; c < 4; ++c) {
+            dst[x * 4 + c] = p0[c] * (256 - f) + p1[c] * f;
+        }
+    }
+}
+
+void BilinearBlendFixedScalar(const qint32* row0, const qint32* row1, int fraction, uchar* dst, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        dst[i] = static_cast<uchar>((row0[i] * (256 - fraction) + row1[i] * fraction + 32768) >> 16);
+    }
+}
+
+#ifdef RIP_AVX2_KERNELS
+// Horizontal pass, 4 output pixels per iteration. Each CMYK pixel is one 32-bit
+// lane: both neighbours are gathered as whole pixels, widened to 16 bits and
+// interleaved so pmaddwd forms p0 * (256 - fx) + p1 * fx for all channels.
+__attribute__((target("avx2")))
+static int bilinearRowAvx2(const uchar* src, qint32* dst, const BilinearTable& table, int dstWidth)
+{
+    const int* srcPixels = reinterpret_cast<const int*>(src);
+    int x = 0;
+    for (; x + 4 <= dstWidth; x += 4) {
+        const __m128i i0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table.index0.constData() + x));
+        const __m128i i1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table.index1.constData() + x));
+        const __m256i p0 = _mm256_cvtepu8_epi16(_mm_i32gather_epi32(srcPixels, i0, 4));
+        const __m256i p1 = _mm256_cvtepu8_epi16(_mm_i32gather_epi32(srcPixels, i1, 4));
+
+        // Lane 0 holds pixels 0/1, lane 1 pixels 2/3: lo = pixels 0 and 2, hi = 1 and 3
+        const __m256i lo = _mm256_unpacklo_epi16(p0, p1);
+        const __m256i hi = _mm256_unpackhi_epi16(p0, p1);
+
+        const __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table.weights.constData() + x));
+        const __m256i wLo = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_shuffle_epi32(w, 0x00)), _mm_shuffle_epi32(w, 0xAA), 1);
+        const __m256i wHi = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_shuffle_epi32(w, 0x55)), _mm_shuffle_epi32(w, 0xFF), 1);
+
+        const __m256i hLo = _mm256_madd_epi16(lo, wLo);
+        const __m256i hHi = _mm256_madd_epi16(hi, wHi);
+
+        // Back to pixel order 0, 1, 2, 3
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), _mm256_permute2x128_si256(hLo, hHi, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4 + 8), _mm256_permute2x128_si256(hLo, hHi, 0x31));
+    }
+    return x;
+}
+
+// Vertical blend, 32 channel values per iteration
+__attribute__((target("avx2")))
+static int bilinearBlendAvx2(const qint32* row0, const qint32* row1, int fraction, uchar* dst, int count)
+{
+    const __m256i w0 = _mm256_set1_epi32(256 - fraction);
+    const __m256i w1 = _mm256_set1_epi32(fraction);
+    const __m256i round = _mm256_set1_epi32(32768);
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i v[4];
+        for (int k = 0; k < 4; ++k) {
+            const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + i + k * 8));
+            const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + i + k * 8));
+            const __m256i sum = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(a, w0), _mm256_mullo_epi32(b, w1)), round);
+            v[k] = _mm256_srli_epi32(sum, 16);
+        }
+        const __m256i bytes = _mm256_packus_epi16(_mm256_packus_epi32(v[0], v[1]), _mm256_packus_epi32(v[2], v[3]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permutevar8x32_epi32(bytes, order));
+    }
+    return i;
+}
+#endif
+
+bool BilinearAvx2Supported()
+{
+#ifdef RIP_AVX2_KERNELS
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+static void bilinearRowFixed(const uchar* src, qint32* dst, const BilinearTable& table, int dstWidth, bool simd)
+{
+    int x = 0;
+#ifdef RIP_AVX2_KERNELS
+    if (simd) {
+        x = bilinearRowAvx2(src, dst, table, dstWidth);
+    }
+#else
+    Q_UNUSED(simd);
+#endif
+    BilinearRowFixedScalar(src, dst, table, x, dstWidth);
+}
+
+static void bilinearBlendFixed(const qint32* row0, const qint32* row1, int fraction, uchar* dst, int count, bool simd)
+{
+    int i = 0;
+#ifdef RIP_AVX2_KERNELS
+    if (simd) {
+        i = bilinearBlendAvx2(row0, row1, fraction, dst, count);
+    }
+#else
+    Q_UNUSED(simd);
+#endif
+    BilinearBlendFixedScalar(row0 + i, row1 + i, fraction, dst + i, count - i);
+}
+
+ResampleRatio ReduceResampleRatio(int srcSize, int dstSize)
+{
+    const int divisor = std::gcd(srcSize, dstSize);
+    ResampleRatio ratio;
+    ratio.numerator = dstSize / divisor;
+    ratio.denominator = srcSize / divisor;
+    return ratio;
+}
+
+bool IsSimpleRatio(const ResampleRatio& ratio)
+{
+    // 150/300 dpi artwork to 720/1440 dpi output gives ratios like 24:5 or 12:5
+    return ratio.numerator <= 64 && ratio.denominator <= 64;
+}
+
+QVector<int> BuildReplicateTable(int srcSize, int dstSize)
+{
+    QVector<int> table(dstSize);
+    const ResampleRatio ratio = ReduceResampleRatio(srcSize, dstSize);
+
+    if (IsSimpleRatio(ratio)) {
+        // Centre of output i in source pixels is (2i + 1) * q / (2p); one period of phases
+        QVector<int> phase(ratio.numerator);
+        for (int r = 0; r < ratio.numerator; ++r) {
+            phase[r] = (2 * r + 1) * ratio.denominator / (2 * ratio.numerator);
+        }
+        for (int i = 0, base = 0, r = 0; i < dstSize; ++i) {
+            table[i] = base + phase[r];
+            if (++r == ratio.numerator) {
+                r = 0;
+                base += ratio.denominator;
+            }
+        }
+    } else {
+        for (int i = 0; i < dstSize; ++i) {
+            table[i] = static_cast<int>((2 * static_cast<qint64>(i) + 1) * srcSize / (2 * static_cast<qint64>(dstSize)));
+        }
+    }
+
+    return table;
+}
+
+// Horizontal pass of the replicating resize
+static void replicatePixels(const uchar* src, uchar* dst, const QVector<int>& table, int srcWidth, int dstWidth)
+{
+    if (dstWidth % srcWidth == 0) {
+        // Integer factor: every source pixel is stored 'factor' times
+        const int factor = dstWidth / srcWidth;
+        for (int x = 0; x < srcWidth; ++x) {
+            quint32 pixel;
+            memcpy(&pixel, src + x * 4, 4);
+            for (int k = 0; k < factor; ++k, dst += 4) {
+                memcpy(dst, &pixel, 4);
+            }
+        }
+        return;
+    }
+
+    for (int x = 0; x < dstWidth; ++x) {
+        memcpy(dst + x * 4, src + table[x] * 4, 4);
+    }
+}
+
+// Horizontal area pass of one source row. Coordinates are in 1/newWidth source
+// pixels, so output i covers [i * width, (i + 1) * width) exactly and the result
+// is the coverage-weighted sum (the mean times width).
+static void areaRowHorizontal(const uchar* src, qint64* prefix, qint64* dst, int width, int newWidth)
+{
+    for (int c = 0; c < 4; ++c) {
+        prefix[c] = 0;
+    }
+    for (int x = 0; x < width; ++x) {
+        for (int c = 0; c < 4; ++c) {
+            prefix[(x + 1) * 4 + c] = prefix[x * 4 + c] + src[x * 4 + c];
+        }
+    }
+
+    for (int i = 0; i < newWidth; ++i) {
+        const qint64 a = static_cast<qint64>(i) * width;
+        const qint64 b = a + width;
+        const int ka = static_cast<int>(a / newWidth);
+        const int kb = static_cast<int>(b / newWidth);
+        const int ra = static_cast<int>(a - static_cast<qint64>(ka) * newWidth);
+        const int rb = static_cast<int>(b - static_cast<qint64>(kb) * newWidth);
+
+        for (int c = 0; c < 4; ++c) {
+            // Integral up to t = k * newWidth + r is newWidth * prefix[k] + r * src[k]
+            qint64 sum = static_cast<qint64>(newWidth) * (prefix[kb * 4 + c] - prefix[ka * 4 + c]) - static_cast<qint64>(ra) * src[ka * 4 + c];
+            if (rb) {
+                sum += static_cast<qint64>(rb) * src[kb * 4 + c];
+            }
+            dst[i * 4 + c] = sum;
+        }
+    }
+}
+
+RowResampler::RowResampler(const QByteArray& cmykDataBuf, int width, int height, int newWidth, int newHeight, ResampleFilter filter)
+    : m_source(cmykDataBuf), m_src(reinterpret_cast<const uchar*>(m_source.constData())),
+      m_width(width), m_height(height), m_newWidth(newWidth), m_newHeight(newHeight),
+      m_mode(Invalid), m_simd(BilinearAvx2Supported()), m_nextY(0), m_lineRow(-1)
+{
+    if (width <= 0 || height <= 0 || newWidth <= 0 || newHeight <= 0 ||
+        cmykDataBuf.size() < static_cast<qsizetype>(width) * height * 4) {
+        qWarning() << "Invalid resample parameters";
+        return;
+    }
+
+    if (newWidth == width && newHeight == height) {
+        m_mode = Copy;
+    } else if (filter == ResampleReplicate) {
+        m_mode = Replicate;
+        m_xReplicate = BuildReplicateTable(width, newWidth);
+        m_yReplicate = BuildReplicateTable(height, newHeight);
+    } else if (filter == ResampleBilinear && newWidth >= width && newHeight >= height) {
+        // Bilinear upscaling never needs more than two taps: fixed-point kernels
+        m_mode = BilinearFixed;
+        m_xBilinear = BuildBilinearTable(width, newWidth);
+        m_yBilinear = BuildBilinearTable(height, newHeight);
+    } else if (filter == ResampleBilinear && newWidth <= width && newHeight <= height) {
+        // Bilinear downscaling averages the covered area instead of sampling
+        m_mode = Area;
+    } else {
+        m_mode = Separable;
+        m_plan = BuildResamplePlan(width, height, newWidth, newHeight, filter);
+    }
+}
+
+void RowResampler::allocateBuffers()
+{
+    const int rowLength = m_newWidth * 4;
+    m_line.resize(rowLength);
+
+    switch (m_mode) {
+    case BilinearFixed:
+        m_fixedRing.resize(2 * rowLength);
+        m_ringRow = QVector<int>(2, -1);
+        break;
+    case Area:
+        m_prefix.resize((m_width + 1) * 4);
+        m_rowSums.resize(rowLength);
+        m_columnSums.resize(rowLength);
+        m_ringRow = QVector<int>(1, -1);
+        break;
+    case Separable:
+        m_floatRing.resize(m_plan.y.taps * rowLength);
+        m_ringRow = QVector<int>(m_plan.y.taps, -1);
+        m_rowPtrs.resize(m_plan.y.taps);
+        break;
+    default:
+        break;
+    }
+}
+
+const uchar* RowResampler::nextRow()
+{
+    if (m_nextY >= m_newHeight) {
+        return nullptr;
+    }
+    return row(m_nextY++);
+}
+
+const uchar* RowResampler::row(int y)
+{
+    if (m_mode == Invalid || y < 0 || y >= m_newHeight) {
+        return nullptr;
+    }
+    if (m_mode == Copy) {
+        return sourceRow(y);
+    }
+    if (m_line.isEmpty()) {
+        allocateBuffers();
+    }
+
+    // Vertical replication: consecutive output rows of one source row share the line
+    if (m_mode == Replicate) {
+        if (m_lineRow != m_yReplicate[y]) {
+            resampleRow(y, m_line.data());
+            m_lineRow = m_yReplicate[y];
+        }
+        return m_line.constData();
+    }
+
+    resampleRow(y, m_line.data());
+    return m_line.constData();
+}
+
+bool RowResampler::readNextRow(uchar* dst)
+{
+    if (m_nextY >= m_newHeight) {
+        return false;
+    }
+    return readRow(m_nextY++, dst);
+}
+
+bool RowResampler::readRow(int y, uchar* dst)
+{
+    if (m_mode == Invalid || y < 0 || y >= m_newHeight) {
+        return false;
+    }
+    if (m_mode == Copy) {
+        memcpy(dst, sourceRow(y), static_cast<size_t>(m_newWidth) * 4);
+        return true;
+    }
+    // Vertical replication: the line is rebuilt only when the source row
+    // changes; repeated rows are copies of it
+    if (m_mode == Replicate) {
+        memcpy(dst, row(y), static_cast<size_t>(m_newWidth) * 4);
+        return true;
+    }
+    if (m_line.isEmpty()) {
+        allocateBuffers();
+    }
+
+    resampleRow(y, dst);
+    return true;
+}
+
+void RowResampler::resampleRow(int y, uchar* dst)
+{
+    switch (m_mode) {
+    case Replicate:
+        replicatePixels(sourceRow(m_yReplicate[y]), dst, m_xReplicate, m_width, m_newWidth);
+        break;
+    case BilinearFixed:
+        bilinearRow(y, dst);
+        break;
+    case Area:
+        areaRow(y, dst);
+        break;
+    default:
+        separableRow(y, dst);
+        break;
+    }
+}
+
+void RowResampler::bilinearRow(int y, uchar* dst)
+{
+    // Two-slot ring of horizontally interpolated source rows
+    const int rowLength = m_newWidth * 4;
+    const qint32* rows[2];
+    for (int t = 0; t < 2; ++t) {
+        const int srcY = t == 0 ? m_yBilinear.index0[y] : m_yBilinear.index1[y];
+        qint32* ringRow = m_fixedRing.data() + (srcY & 1) * rowLength;
+        if (m_ringRow[srcY & 1] != srcY) {
+            bilinearRowFixed(sourceRow(srcY), ringRow, m_xBilinear, m_newWidth, m_simd);
+            m_ringRow[srcY & 1] = srcY;
+        }
+        rows[t] = ringRow;
+    }
+
+    bilinearBlendFixed(rows[0], rows[1], m_yBilinear.fraction[y], dst, rowLength, m_simd);
+}
+
+void RowResampler::areaRow(int y, uchar* dst)
+{
+    // Output row y covers [y * height, (y + 1) * height) in 1/newHeight rows
+    const int rowLength = m_newWidth * 4;
+    const qint64 a = static_cast<qint64>(y) * m_height;
+    const qint64 e = a + m_height;
+    qint64* columnSums = m_columnSums.data();
+    qint64* rowSums = m_rowSums.data();
+    std::fill(columnSums, columnSums + rowLength, 0);
+
+    for (int r = static_cast<int>(a / m_newHeight); static_cast<qint64>(r) * m_newHeight < e; ++r) {
+        // A source row straddling two output rows is reduced only once
+        if (m_ringRow[0] != r) {
+            areaRowHorizontal(sourceRow(r), m_prefix.data(), rowSums, m_width, m_newWidth);
+            m_ringRow[0] = r;
+        }
+        const qint64 weight = std::min(e, static_cast<qint64>(r + 1) * m_newHeight) - std::max(a, static_cast<qint64>(r) * m_newHeight);
+        for (int i = 0; i < rowLength; ++i) {
+            columnSums[i] += rowSums[i] * weight;
+        }
+    }
+
+    const qint64 area = static_cast<qint64>(m_width) * m_height;
+    for (int i = 0; i < rowLength; ++i) {
+        dst[i] = static_cast<uchar>((columnSums[i] + area / 2) / area);
+    }
+}
+
+void RowResampler::separableRow(int y, uchar* dst)
+{
+    // Ring of horizontally resampled source rows. The source window only moves
+    // down, so 'taps' slots hold every row an output row needs.
+    const int rowLength = m_newWidth * 4;
+    const int taps = m_plan.y.taps;
+    const int start = m_plan.y.start[y];
+    const float* weights = m_plan.y.weights.constData() + y * taps;
+    const float** rowPtrs = m_rowPtrs.data();
+
+    for (int t = 0; t < taps; ++t) {
+        const int srcY = start + t;
+        const int slot = srcY % taps;
+        float* ringRow = m_floatRing.data() + slot * rowLength;
+        if (m_ringRow[slot] != srcY) {
+            ResampleRowHorizontal(sourceRow(srcY), ringRow, m_plan.x, m_newWidth);
+            m_ringRow[slot] = srcY;
+        }
+        rowPtrs[t] = ringRow;
+    }
+
+    // Vertical pass: a weighted sum of whole rows, contiguous and branch free
+    for (int i = 0; i < rowLength; ++i) {
+        float value = 0.0f;
+        for (int t = 0; t < taps; ++t) {
+            value += weights[t] * rowPtrs[t][i];
+        }
+        dst[i] = static_cast<uchar>(std::clamp(value + 0.5f, 0.0f, 255.0f));
+    }
+}
+
+QByteArray ResampleCMYK(const QByteArray& cmykDataBuf, int width, int height, int newWidth, int newHeight, ResampleFilter filter)
+{
+    const RowResampler resampler(cmykDataBuf, width, height, newWidth, newHeight, filter);
+    if (!resampler.isValid()) {
+        return QByteArray();
+    }
+    if (newWidth == width && newHeight == height) {
+        return cmykDataBuf;
+    }
+
+    QByteArray resizedCmykDataBuf(static_cast<qsizetype>(newWidth) * newHeight * 4, Qt::Uninitialized);
+    uchar* outputData = reinterpret_cast<uchar*>(resizedCmykDataBuf.data());
+    const qsizetype rowLength = static_cast<qsizetype>(newWidth) * 4;
+
+    // Split the output into fixed bands; each band pulls its rows through its
+    // own copy of the resampler
+    const int bandCount = (newHeight + kParallelBandRows - 1) / kParallelBandRows;
+    QVector<int> bands(bandCount);
+    for (int b = 0; b < bandCount; ++b) {
+        bands[b] = b;
+    }
+
+    QtConcurrent::blockingMap(bands, [&](int b) {
+        const int y0 = b * kParallelBandRows;
+        const int y1 = std::min(newHeight, y0 + kParallelBandRows);
+        RowResampler band = resampler;
+        for (int y = y0; y < y1; ++y) {
+            memcpy(outputData + y * rowLength, band.row(y), rowLength);
+        }
+    });
+
+    return resizedCmykDataBuf;
+}
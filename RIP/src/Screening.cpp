@@ -0,0 +1,446 @@
+#include "Screening.h"
+#include "BitPacking.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RIP_SSE_SCREENING 1
+#endif
+
+// Spreads the ranks of an n-pixel tile evenly over the thresholds 0..254
+template <typename Rank>
+static ThresholdTile tileFromRanks(int width, int height, const QVector<Rank>& ranks) {
+    const int n = width * height;
+    ThresholdTile tile;
+    tile.width = width;
+    tile.height = height;
+    tile.thresholds.resize(n);
+    for (int i = 0; i < n; ++i) {
+        tile.thresholds[i] = static_cast<uchar>(static_cast<qint64>(ranks[i]) * 255 / n);
+    }
+    return tile;
+}
+
+ThresholdTile BayerTile() {
+    const quint16 bayerMap[64] = {
+         0, 32,  8, 40,  2, 34, 10, 42,
+        48, 16, 56, 24, 50, 18, 58, 26,
+        12, 44,  4, 36, 14, 46,  6, 38,
+        60, 28, 52, 20, 62, 30, 54, 22,
+         3, 35, 11, 43,  1, 33,  9, 41,
+        51, 19, 59, 27, 49, 17, 57, 25,
+        15, 47,  7, 39, 13, 45,  5, 37,
+        63, 31, 55, 23, 61, 29, 53, 21
+    };
+    return tileFromRanks(8, 8, QVector<quint16>(bayerMap, bayerMap + 64));
+}
+
+// Gaussian energy of a binary pattern on a torus, with the tightest cluster of
+// set pixels and the largest void of unset ones. Toggling a pixel updates the
+// energy around it and rescans only the rows it touched.
+class VoidAndCluster {
+public:
+    VoidAndCluster(int size, float sigma)
+        : m_size(size), m_radius(std::min(8, (size - 1) / 2)),
+          m_bits(size * size, 0), m_energy(size * size, 0.0f),
+          m_rowCluster(size, -1), m_rowVoid(size, -1)
+    {
+        const int span = 2 * m_radius + 1;
+        m_kernel.resize(span * span);
+        for (int dy = -m_radius; dy <= m_radius; ++dy) {
+            for (int dx = -m_radius; dx <= m_radius; ++dx) {
+                m_kernel[(dy + m_radius) * span + dx + m_radius] = std::exp(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+            }
+        }
+        for (int y = 0; y < m_size; ++y) {
+            scanRow(y);
+        }
+    }
+
+    bool isSet(int p) const { return m_bits[p] != 0; }
+
+    void toggle(int p) {
+        const int px = p % m_size;
+        const int py = p / m_size;
+        const float sign = m_bits[p] ? -1.0f : 1.0f;
+        m_bits[p] ^= 1;
+
+        const int span = 2 * m_radius + 1;
+        for (int dy = -m_radius; dy <= m_radius; ++dy) {
+            const int y = (py + dy + m_size) % m_size;
+            float* energyRow = m_energy.data() + y * m_size;
+            const float* kernelRow = m_kernel.constData() + (dy + m_radius) * span + m_radius;
+            for (int dx = -m_radius; dx <= m_radius; ++dx) {
+                energyRow[(px + dx + m_size) % m_size] += sign * kernelRow[dx];
+            }
+        }
+        for (int dy = -m_radius; dy <= m_radius; ++dy) {
+            scanRow((py + dy + m_size) % m_size);
+        }
+    }
+
+    // Set pixel with the highest energy, -1 if none
+    int tightestCluster() const {
+        int best = -1;
+        for (int y = 0; y < m_size; ++y) {
+            const int p = m_rowCluster[y];
+            if (p >= 0 && (best < 0 || m_energy[p] > m_energy[best])) {
+                best = p;
+            }
+        }
+        return best;
+    }
+
+    // Unset pixel with the lowest energy, -1 if none
+    int largestVoid() const {
+        int best = -1;
+        for (int y = 0; y < m_size; ++y) {
+            const int p = m_rowVoid[y];
+            if (p >= 0 && (best < 0 || m_energy[p] < m_energy[best])) {
+                best = p;
+            }
+        }
+        return best;
+    }
+
+private:
+    void scanRow(int y) {
+        int cluster = -1;
+        int emptiest = -1;
+        for (int p = y * m_size; p < (y + 1) * m_size; ++p) {
+            if (m_bits[p]) {
+                if (cluster < 0 || m_energy[p] > m_energy[cluster]) {
+                    cluster = p;
+                }
+            } else if (emptiest < 0 || m_energy[p] < m_energy[emptiest]) {
+                emptiest = p;
+            }
+        }
+        m_rowCluster[y] = cluster;
+        m_rowVoid[y] = emptiest;
+    }
+
+    int m_size;
+    int m_radius;               // Kernel cut-off, where the weights are below 1e-6
+    QVector<float> m_kernel;
+    QVector<uchar> m_bits;
+    QVector<float> m_energy;
+    QVector<int> m_rowCluster;  // Tightest cluster of every row
+    QVector<int> m_rowVoid;     // Largest void of every row
+};
+
+QVector<quint16> GenerateBlueNoiseRanks(int size) {
+    const int n = size * size;
+    VoidAndCluster pattern(size, 1.5f);
+
+    // Initial pattern: a tenth of the pixels at (reproducible) random positions,
+    // then move the tightest cluster into the largest void until it is stable
+    quint32 seed = 12345;
+    int ones = 0;
+    while (ones < n / 10) {
+        seed = seed * 1664525u + 1013904223u;
+        const int p = static_cast<int>((static_cast<quint64>(seed >> 8) * n) >> 24);
+        if (!pattern.isSet(p)) {
+            pattern.toggle(p);
+            ++ones;
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        const int cluster = pattern.tightestCluster();
+        pattern.toggle(cluster);
+        const int emptiest = pattern.largestVoid();
+        pattern.toggle(emptiest);
+        if (emptiest == cluster) {
+            break;
+        }
+    }
+
+    QVector<quint16> ranks(n);
+
+    // Phase 1: remove the tightest clusters of the initial pattern, ranking
+    // them downwards
+    VoidAndCluster removing = pattern;
+    for (int rank = ones - 1; rank >= 0; --rank) {
+        const int cluster = removing.tightestCluster();
+        removing.toggle(cluster);
+        ranks[cluster] = static_cast<quint16>(rank);
+    }
+
+    // Phases 2 and 3: fill the largest voids up to the full tile. On a torus
+    // the tightest cluster of the unset pixels is the largest void of the set
+    // ones, so both phases are the same search.
+    for (int rank = ones; rank < n; ++rank) {
+        const int emptiest = pattern.largestVoid();
+        pattern.toggle(emptiest);
+        ranks[emptiest] = static_cast<quint16>(rank);
+    }
+
+    return ranks;
+}
+
+// Cached tiles are the raw ranks after a small header
+static const quint32 kBlueNoiseMagic = 0x31564E42;    // "BNV1"
+
+static QString blueNoiseCachePath(int size) {
+    QString folder = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (folder.isEmpty()) {
+        folder = QDir::tempPath();
+    }
+    return folder + QString("/bluenoise-%1.bin").arg(size);
+}
+
+static bool loadBlueNoiseRanks(const QString& path, int size, QVector<quint16>& ranks) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const int n = size * size;
+    QByteArray data = file.readAll();
+    file.close();
+    if (data.size() != 8 + n * 2) {
+        return false;
+    }
+
+    const uchar* bytes = reinterpret_cast<const uchar*>(data.constData());
+    if (qFromLittleEndian<quint32>(bytes) != kBlueNoiseMagic || qFromLittleEndian<quint32>(bytes + 4) != static_cast<quint32>(size)) {
+        return false;
+    }
+    // The ranks must be a permutation of 0 .. n - 1: a missing or repeated
+    // rank would bias the thresholds and with them the tone response
+    ranks.resize(n);
+    QVector<bool> seen(n, false);
+    for (int i = 0; i < n; ++i) {
+        ranks[i] = qFromLittleEndian<quint16>(bytes + 8 + i * 2);
+        if (ranks[i] >= n || seen[ranks[i]]) {
+            qWarning() << "Invalid blue noise cache, regenerating:" << path;
+            return false;
+        }
+        seen[ranks[i]] = true;
+    }
+    return true;
+}
+
+static void saveBlueNoiseRanks(const QString& path, int size, const QVector<quint16>& ranks) {
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write blue-noise cache:" << path;
+        return;
+    }
+
+    QByteArray data(8 + ranks.size() * 2, Qt::Uninitialized);
+    uchar* bytes = reinterpret_cast<uchar*>(data.data());
+    qToLittleEndian<quint32>(kBlueNoiseMagic, bytes);
+    qToLittleEndian<quint32>(static_cast<quint32>(size), bytes + 4);
+    for (int i = 0; i < ranks.size(); ++i) {
+        qToLittleEndian<quint16>(ranks[i], bytes + 8 + i * 2);
+    }
+    file.write(data);
+    if (!file.commit()) {
+        qWarning() << "Failed to write blue-noise cache:" << path;
+    }
+}
+
+ThresholdTile BlueNoiseTile(int size) {
+    static QMutex mutex;
+    static QHash<int, ThresholdTile> tiles;
+    QMutexLocker locker(&mutex);
+
+    if (tiles.contains(size)) {
+        return tiles.value(size);
+    }
+
+    QVector<quint16> ranks;
+    const QString path = blueNoiseCachePath(size);
+    if (!loadBlueNoiseRanks(path, size, ranks)) {
+        ranks = GenerateBlueNoiseRanks(size);
+        saveBlueNoiseRanks(path, size, ranks);
+    }
+
+    ThresholdTile tile = tileFromRanks(size, size, ranks);
+    tiles.insert(size, tile);
+    return tile;
+}
+
+// Rational-tangent AM cell: the dot lattice is spanned by (p, q) / m and
+// (-q, p) / m with p = k * a, q = k * b for a small coprime a:b. It then
+// repeats every (a^2 + b^2) * k / gcd(m, k * (a^2 + b^2)) pixels along x and y.
+struct AmCell {
+    int a;
+    int b;
+    int k;
+    int m;
+    int size;
+};
+
+static AmCell fitAmCell(double angle, double cellLength) {
+    const double pi = 3.14159265358979323846;
+    angle = std::fmod(std::fmod(angle, 90.0) + 90.0, 90.0);
+    AmCell best = { 1, 0, std::max(1, qRound(cellLength)), 1, std::max(1, qRound(cellLength)) };
+    double bestScore = 1e30;
+
+    for (int a = 1; a <= 16; ++a) {
+        for (int b = 0; b <= 16; ++b) {
+            if (std::gcd(a, b) != 1) {
+                continue;
+            }
+            const double cellAngle = std::atan2(b, a) * 180.0 / pi;
+            if (std::abs(cellAngle - angle) > 3.0) {
+                continue;
+            }
+            const int norm = a * a + b * b;
+            for (int m = 1; m <= 8; ++m) {
+                const int k0 = qRound(cellLength * m / std::sqrt(static_cast<double>(norm)));
+                for (int k = std::max(1, k0 - 1); k <= k0 + 1; ++k) {
+                    const int size = norm * k / std::gcd(m, norm * k);
+                    if (size > 512) {
+                        continue;
+                    }
+                    // One degree off weighs as much as 1% off in frequency
+                    const double length = k * std::sqrt(static_cast<double>(norm)) / m;
+                    const double score = std::abs(cellAngle - angle) + 100.0 * std::abs(length - cellLength) / cellLength;
+                    if (score < bestScore - 1e-9 || (score < bestScore + 1e-9 && size < best.size)) {
+                        bestScore = score;
+                        best = { a, b, k, m, size };
+                    }
+                }
+            }
+        }
+    }
+    return best;
+}
+
+// Dot spacing of an AM screen in device pixels
+static double amCellLength(float lpi, float resolution) {
+    return std::max(1.0, static_cast<double>(resolution) / std::max(lpi, 1.0f));
+}
+
+ThresholdTile AmScreenTile(float angle, float lpi, float resolution) {
+    static QMutex mutex;
+    static QHash<QString, ThresholdTile> tiles;
+    QMutexLocker locker(&mutex);
+
+    const QString key = QString("%1/%2/%3").arg(angle).arg(lpi).arg(resolution);
+    if (tiles.contains(key)) {
+        return tiles.value(key);
+    }
+
+    const AmCell cell = fitAmCell(angle, amCellLength(lpi, resolution));
+    const int size = cell.size;
+    const double scale = static_cast<double>(cell.m) / (cell.k * (cell.a * cell.a + cell.b * cell.b));
+
+    // Cosine spot function at every pixel centre: highest in the middle of a
+    // dot, so dots grow from their centres and join as a checkerboard at 50%
+    const double pi = 3.14159265358979323846;
+    QVector<double> spot(size * size);
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            const double u = ((x + 0.5) * cell.a + (y + 0.5) * cell.b) * scale;
+            const double v = ((y + 0.5) * cell.a - (x + 0.5) * cell.b) * scale;
+            spot[y * size + x] = std::cos(2.0 * pi * u) + std::cos(2.0 * pi * v);
+        }
+    }
+
+    // Pixels turn on in order of decreasing spot value
+    QVector<int> order(size * size);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int i, int j) { return spot[i] > spot[j]; });
+    QVector<quint32> ranks(size * size);
+    for (int rank = 0; rank < order.size(); ++rank) {
+        ranks[order[rank]] = static_cast<quint32>(rank);
+    }
+
+    ThresholdTile tile = tileFromRanks(size, size, ranks);
+    tiles.insert(key, tile);
+    return tile;
+}
+
+ThresholdTile ScreenTile(int method) {
+    switch (method) {
+    case ScreenBlueNoise:
+        return BlueNoiseTile(256);
+    case ScreenBayer:
+    default:
+        return BayerTile();
+    }
+}
+
+void PlaneScreen(int method, int plane, int source, float lpi, float resolution,
+                 ThresholdTile& tile, int& offsetX, int& offsetY) {
+    if (method == ScreenAM) {
+        const float angle = kAmScreenAngles[std::clamp(source, 0, 3)];
+        tile = AmScreenTile(angle, lpi, resolution);
+        offsetX = 0;
+        offsetY = 0;
+        if (plane >= 4) {
+            // A light ink shares the lattice of its base ink, shifted by part
+            // of a cell so its dots sit between the base ink's dots. Lights of
+            // one base ink (Lk, LLk) are consecutive planes and take different
+            // positions in the cell.
+            static const double kLightPhases[3][2] = { {0.5, 0.5}, {0.5, 0.0}, {0.0, 0.5} };
+            const double* phase = kLightPhases[(plane - 4) % 3];
+            const AmCell cell = fitAmCell(angle, amCellLength(lpi, resolution));
+            const double period = static_cast<double>(cell.k) / cell.m;
+            const int dx = qRound((phase[0] * cell.a - phase[1] * cell.b) * period);
+            const int dy = qRound((phase[0] * cell.b + phase[1] * cell.a) * period);
+            offsetX = (dx % tile.width + tile.width) % tile.width;
+            offsetY = (dy % tile.height + tile.height) % tile.height;
+        }
+        return;
+    }
+    tile = ScreenTile(method);
+    ScreenOffset(tile, plane, offsetX, offsetY);
+}
+
+void ScreenOffset(const ThresholdTile& tile, int plane, int& offsetX, int& offsetY) {
+    // R2 low-discrepancy sequence: the offsets of any number of planes stay
+    // far apart from each other
+    const double fx = std::fmod(plane * 0.7548776662466927, 1.0);
+    const double fy = std::fmod(plane * 0.5698402909980532, 1.0);
+    offsetX = static_cast<int>(fx * tile.width);
+    offsetY = static_cast<int>(fy * tile.height);
+}
+
+#ifdef RIP_SSE_SCREENING
+// Levels of 16 pixels: base + (remainder > threshold), as an unsigned compare
+static inline __m128i screenLevels(const uchar* base, const uchar* remainder, const uchar* thresholds) {
+    const __m128i excess = _mm_subs_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(remainder)),
+                                         _mm_loadu_si128(reinterpret_cast<const __m128i*>(thresholds)));
+    const __m128i notAbove = _mm_cmpeq_epi8(excess, _mm_setzero_si128());
+    return _mm_add_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(base)),
+                        _mm_andnot_si128(notAbove, _mm_set1_epi8(1)));
+}
+#endif
+
+void ScreenRow(const uchar* base, const uchar* remainder, const uchar* thresholds,
+               int count, int bitsPerPixel, uchar* packed) {
+    // Levels of a span of pixels, then packed in one pass
+    const int span = 256;
+    uchar levels[span];
+    for (int x0 = 0; x0 < count; x0 += span) {
+        const int n = std::min(span, count - x0);
+#ifdef RIP_SSE_SCREENING
+        for (int x = 0; x < n; x += 16) {
+            const int i = x0 + x;
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(levels + x), screenLevels(base + i, remainder + i, thresholds + i));
+        }
+#else
+        for (int x = 0; x < n; ++x) {
+            const int i = x0 + x;
+            levels[x] = static_cast<uchar>(base[i] + (remainder[i] > thresholds[i]));
+        }
+#endif
+        PackLevels(levels, n, bitsPerPixel, packed + x0 * bitsPerPixel / 8);
+    }
+}
@@ -4,6 +4,7 @@
 #include <QString>
 #include <QFile>
 #include <QXmlStreamReader>
+#include <QMap>
 
 class JobSettings
 {
@@ -25,6 +26,19 @@ public:
     float heightPercentage() const { return m_heightPercentage; }
     float width() const { return m_width; }
     float height() const { return m_height; }
+    int resampleFilter() const { return m_resampleFilter; }
+    int diffusionKernel() const { return m_diffusionKernel; }
+    bool serpentine() const { return m_serpentine; }
+    bool stripDiffusion() const { return m_stripDiffusion; }
+    bool fixedPointDiffusion() const { return m_fixedPointDiffusion; }
+    float screenLpi() const { return m_screenLpi; }
+    QString calibrationFile() const { return m_calibrationFile; }
+    int brightness() const { return m_brightness; }
+    int contrast() const { return m_contrast; }
+    int saturation() const { return m_saturation; }
+    QString redCurve() const { return m_redCurve; }
+    QString greenCurve() const { return m_greenCurve; }
+    QString blueCurve() const { return m_blueCurve; }
 
     // Getters for boolean fields
     bool c() const { return m_c; }
@@ -42,6 +56,13 @@ public:
     bool s5() const { return m_s5; }
     bool s6() const { return m_s6; }
 
+    // Light-ink split curve ("start,peak,end") for an ink, empty for the default
+    QString inkSplit(const QString& ink) const { return m_inkSplits.value(ink); }
+
+    // Drop densities ("d0,d1,...", one per output code) for an ink, empty for
+    // evenly spaced levels
+    QString inkDrops(const QString& ink) const { return m_inkDrops.value(ink); }
+
 private:
     void parseXml(QXmlStreamReader& xml);
 
@@ -58,6 +79,19 @@ private:
     float m_heightPercentage;
     float m_width;
     float m_height;
+    int m_resampleFilter;
+    int m_diffusionKernel;
+    bool m_serpentine;
+    bool m_stripDiffusion;
+    bool m_fixedPointDiffusion;
+    float m_screenLpi;
+    QString m_calibrationFile;
+    int m_brightness;
+    int m_contrast;
+    int m_saturation;
+    QString m_redCurve;
+    QString m_greenCurve;
+    QString m_blueCurve;
 
     // Boolean fields
     bool m_c;
@@ -74,6 +108,12 @@ private:
     bool m_s4;
     bool m_s5;
     bool m_s6;
+
+    // Light-ink split curves keyed by ink name (C, Lc, M, Lm, K, Lk, LLk)
+    QMap<QString, QString> m_inkSplits;
+
+    // Drop densities keyed by ink name
+    QMap<QString, QString> m_inkDrops;
 };
 
 void writeWidthAndHeightToXml(const QString& filePath, double width, double height);
@@ -36,6 +36,7 @@ private:
     double originalWidth; // Original width in cm
     double originalHeight; // Original height in cm
     QString m_guid;
+    QList<QPair<QString, QString>> m_extraSettings; // Job settings this dialog does not edit (ink curves, ...)
     void loadSettingsFromXML(); // Load settings from Settings.xml
     void updateSizeFields(); // Update width and height fields proportionally
     void loadICCProfiles();
@@ -127,6 +127,7 @@ void SettingsDialog::loadSettings(const QString& guid)
     }
     int nindex = 0;
     QString qstr;
+    m_extraSettings.clear();
     QXmlStreamReader xml(&file);
     while (!xml.atEnd()) {
         xml.readNext();
@@ -177,6 +178,10 @@ void SettingsDialog::loadSettings(const QString& guid)
                 ui->widthPercentageSpinBox->setValue(xml.readElementText().toInt());
             } else if (xml.name() == "HeightPercentage") {
                 ui->heightPercentageSpinBox->setValue(xml.readElementText().toInt());
+            } else if (xml.name() != "settings") {
+                // Keep settings without a widget so that saving does not drop them
+                QString name = xml.name().toString();
+                m_extraSettings.append(qMakePair(name, xml.readElementText()));
             }
         }
     }
@@ -234,6 +239,11 @@ void SettingsDialog::saveSettings(const QString& guid)
     xml.writeTextElement("WidthPercentage", QString::number(ui->widthPercentageSpinBox->value()));
     xml.writeTextElement("HeightPercentage", QString::number(ui->heightPercentageSpinBox->value()));
 
+    // Write back the settings edited outside this dialog
+    for (const auto& setting : m_extraSettings) {
+        xml.writeTextElement(setting.first, setting.second);
+    }
+
     xml.writeEndElement();
     xml.writeEndDocument();
 
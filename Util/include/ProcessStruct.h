@@ -4,6 +4,7 @@
 #include <QByteArray>
 #include <QString>
 #include "JobSettings.h"
+#include "InkCurves.h"
 
 // Define the info structure to process the image
 #pragma pack(push, 1) // Ensure the structure is packed without padding
@@ -28,11 +29,17 @@ struct TagJobInfoRecord {
     float widthPercentage;      // Width scaling percentage
     float heightPercentage;     // Height scaling percentage
     int nLevel;                 // Number of levels for dithering
-    int nPixelPerByte;          // Number of pixels per byte
+    int nPixelPerByte;          // Number of whole pixels per byte (2 for 3-bit output)
     int OutputWidth;            // Output width
     int OutputHeight;            // Output width
     float xTimes;               // X scaling factor
     float yTimes;               // Y scaling factor
+    int resampleFilter;         // Resampling filter (0=bilinear, 1=Mitchell, 2=Lanczos-3, 3=replicate)
+    int diffusionKernel;        // Error diffusion kernel (0=Floyd-Steinberg, 1=JJN, 2=Stucki, 3=Sierra-3, 4=Sierra-2, 5=Sierra-Lite, 6=variable, 7=variable with threshold modulation)
+    bool serpentine;            // Alternate the scan direction of error diffusion rows
+    bool stripDiffusion;        // Diffuse vertical strips independently (short, wide jobs)
+    bool fixedPointDiffusion;   // Diffuse integer errors in 1/32 ink level instead of floats
+    float screenLpi;            // AM screen frequency in lines per inch
     bool cc;                    // Cyan channel enabled
     bool mm;                    // Magenta channel enabled
     bool yy;                    // Yellow channel enabled
@@ -47,6 +54,14 @@ struct TagJobInfoRecord {
     bool ss4;                   // Spot color 4 enabled
     bool ss5;                   // Spot color 5 enabled
     bool ss6;                   // Spot color 6 enabled
+    int nColors;                // Number of output ink planes
+    QVector<InkPlane> inkPlanes; // Output ink planes with their split tables
+    int brightness;             // Brightness adjustment (-100..100)
+    int contrast;               // Contrast adjustment (-100..100)
+    int saturation;             // Saturation adjustment (-100..100)
+    QString redCurve;           // Red tone curve control points
+    QString greenCurve;         // Green tone curve control points
+    QString blueCurve;          // Blue tone curve control points
 };
 #pragma pack(pop) // Restore default packing
 
@@ -67,6 +82,8 @@ struct tagHeadRecord_1 {
 #pragma pack(pop) // Restore default packing
 
 void FillJobInfoStruct(JobSettings& settings, QImage& image, TagJobInfoRecord& Info);
+// Same, from the image geometry alone (pixel size and dots per meter), before it is decoded
+void FillJobInfoStruct(JobSettings& settings, const QSize& imageSize, int dotsPerMeterX, int dotsPerMeterY, TagJobInfoRecord& Info);
 int FillHeaderStruct(TagJobInfoRecord& settings, QByteArray* Headbuf);
 
 #endif // PROCESSSTRUCT_H
@@ -1,16 +1,22 @@
 #include "../../include.h"
 
 #include "../include/ProcessStruct.h"
+#include "BitPacking.h"
 
 void FillJobInfoStruct(JobSettings& settings, QImage& image, TagJobInfoRecord& Info)
+{
+    FillJobInfoStruct(settings, image.size(), image.dotsPerMeterX(), image.dotsPerMeterY(), Info);
+}
+
+void FillJobInfoStruct(JobSettings& settings, const QSize& imageSize, int dotsPerMeterX, int dotsPerMeterY, TagJobInfoRecord& Info)
 {
     // Use the loaded settings
     Info.header = settings.header();
     Info.dithering = settings.dithering();
     Info.xResolution = settings.xResolution();
     Info.yResolution = settings.yResolution();
-    Info.xImageResolution = 2.54*image.dotsPerMeterX()/100;
-    Info.yImageResolution = 2.54*image.dotsPerMeterY()/100;
+    Info.xImageResolution = 2.54*dotsPerMeterX/100;
+    Info.yImageResolution = 2.54*dotsPerMeterY/100;
     Info.importRGBProfile = settings.importRGBProfile();
     Info.importCMYKProfile = settings.importCMYKProfile();
     Info.outputProfile = settings.outputProfile();
@@ -18,6 +24,8 @@ void FillJobInfoStruct(JobSettings& settings, QImage& image, TagJobInfoRecord& I
     Info.widthPercentage = settings.widthPercentage();
     Info.heightPercentage = settings.heightPercentage();
     Info.outputBuffSize = 0;
+    Info.width = imageSize.width();
+    Info.height = imageSize.height();
     Info.nLevel = 2;
     switch(Info.dithering%3){
     case 1:
@@ -25,12 +33,26 @@ void FillJobInfoStruct(JobSettings& settings, QImage& image, TagJobInfoRecord& I
     case 2:
         Info.nLevel = 4;
     }
-    Info.nPixelPerByte = 8/((Info.nLevel + 1)/2);
-    Info.OutputWidth = static_cast<int>(std::round(image.width()*Info.widthPercentage/100/image.dotsPerMeterX()*100/2.54*Info.xResolution)) ;
-    Info.OutputHeight = static_cast<int>(std::round(image.height()*Info.heightPercentage/100/image.dotsPerMeterY()*100/2.54*Info.yResolution));
-    Info.bytePerLine = static_cast<int>(std::ceil(static_cast<float>(Info.OutputWidth)/Info.nPixelPerByte));
-    Info.xTimes = static_cast<float>(Info.OutputWidth)/image.width();
-    Info.yTimes =static_cast<float>(Info.OutputHeight)/image.height();
+
+    // Output ink planes, including the light-ink split, drop density and
+    // calibration tables. Drop densities can raise the level count of the job.
+    Info.inkPlanes = BuildInkPlanes(settings, Info.nLevel);
+    Info.nColors = Info.inkPlanes.size();
+    Info.nLevel = OutputLevels(Info.inkPlanes);
+
+    Info.level = Info.nLevel;
+    Info.nPixelPerByte = 8/BitsPerPixel(Info.nLevel);
+    Info.OutputWidth = static_cast<int>(std::round(imageSize.width()*Info.widthPercentage/100/dotsPerMeterX*100/2.54*Info.xResolution)) ;
+    Info.OutputHeight = static_cast<int>(std::round(imageSize.height()*Info.heightPercentage/100/dotsPerMeterY*100/2.54*Info.yResolution));
+    Info.bytePerLine = (Info.OutputWidth*BitsPerPixel(Info.nLevel) + 7)/8;
+    Info.xTimes = static_cast<float>(Info.OutputWidth)/imageSize.width();
+    Info.yTimes =static_cast<float>(Info.OutputHeight)/imageSize.height();
+    Info.resampleFilter = std::clamp(settings.resampleFilter(), 0, 3);
+    Info.diffusionKernel = std::clamp(settings.diffusionKernel(), 0, 7);
+    Info.serpentine = settings.serpentine();
+    Info.stripDiffusion = settings.stripDiffusion();
+    Info.fixedPointDiffusion = settings.fixedPointDiffusion();
+    Info.screenLpi = settings.screenLpi() > 0.0f ? settings.screenLpi() : 60.0f;
     Info.OutputWidth = settings.width();
     Info.OutputHeight = settings.height();
     // Boolean fields
@@ -49,6 +71,14 @@ void FillJobInfoStruct(JobSettings& settings, QImage& image, TagJobInfoRecord& I
     Info.ss5 = settings.s5();
     Info.ss6 = settings.s6();
 
+    // Tone adjustments, folded into the colour conversion
+    Info.brightness = settings.brightness();
+    Info.contrast = settings.contrast();
+    Info.saturation = settings.saturation();
+    Info.redCurve = settings.redCurve();
+    Info.greenCurve = settings.greenCurve();
+    Info.blueCurve = settings.blueCurve();
+
 return;
 }
 
@@ -78,8 +108,8 @@ int FillHeaderStruct(TagJobInfoRecord& settings, QByteArray* Headbuf)
         header->nHeight = settings.OutputHeight;
         header->nWidth = settings.OutputWidth;
         header->nPaperWidth = 0;     // Not used
-        header->nColors = 4;         // CMYK
-        header->nBits = (settings.nLevel+1)/2;           // Not used
+        header->nColors = settings.nColors; // CMYK + light inks
+        header->nBits = BitsPerPixel(settings.nLevel);   // Not used
         header->nReserved[0] = 0;    // Pass Number
         header->nReserved[1] = 0;    // vsdMode
         header->nReserved[2] = 0;    // Reserved
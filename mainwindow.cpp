@@ -108,17 +108,21 @@ void MainWindow::onJobSelected(QTreeWidgetItem *item, int column)
         ui->sendJobButton->setEnabled(false);
     }
 
+    // Only decode what the preview shows; the job decodes at its own resolution
     m_curfilePath = item->text(0);
-    QImage image(m_curfilePath);
+    QImage image = loadPreviewImage(m_curfilePath, ui->previewLabel->size(), &m_curImageSize);
     m_curImage = image;
 
     if (image.isNull()) {
         ui->previewLabel->setText("Failed to load image!");
     } else {
-        ui->previewLabel->setPixmap(QPixmap::fromImage(image.scaled(ui->previewLabel->size(), Qt::KeepAspectRatio, Qt::SmoothTransformation)));
+        ui->previewLabel->setPixmap(QPixmap::fromImage(image));
     }
 
-    qsizetype si = image.sizeInBytes();
+    // Bytes of the image decoded at full size: the preview has the pixel
+    // format of the source, only fewer pixels (scan lines are 32-bit aligned)
+    qsizetype si = static_cast<qsizetype>((static_cast<qint64>(m_curImageSize.width()) * image.depth() + 31) / 32 * 4)
+                   * m_curImageSize.height();
     QFileInfo fileInfo(m_curfilePath);
     ui->jobNameLabel->setText(m_curfilePath);
 
@@ -134,8 +138,8 @@ void MainWindow::onJobSelected(QTreeWidgetItem *item, int column)
         ui->resolutionLabel->setText("N/A");
     }
 
-    int widthPixels = image.width();
-    int heightPixels = image.height();
+    int widthPixels = m_curImageSize.width();
+    int heightPixels = m_curImageSize.height();
     QFile Imgf(m_curfilePath);
     float imgByte = (float)Imgf.size() / 1024;
 
@@ -276,15 +280,41 @@ bool MainWindow::sendJobProcess(QImage& image, QString& guid)
         return false;
     }
 
-    // Populate the TagJobInfoRecord structure using FillJobInfoStruct
+    // Plan the output size from the image geometry (the preview carries the
+    // resolution), then decode no more of the image than that needs
     TagJobInfoRecord jobInfo;
-    FillJobInfoStruct(jobSettings, image, jobInfo);
+    FillJobInfoStruct(jobSettings, m_curImageSize, image.dotsPerMeterX(), image.dotsPerMeterY(), jobInfo);
+    QSize outputSize(qRound(jobInfo.width * jobInfo.xTimes), qRound(jobInfo.height * jobInfo.yTimes));
+    QImage jobImage = loadJobImage(m_curfilePath, outputSize);
+    if (jobImage.isNull()) {
+        qWarning() << "Failed to load image for job:" << selectedJobFullPath;
+        return false;
+    }
+
+    // The decode scale only changes the pixels the resize starts from: the
+    // planned output size, resolution and header stay as planned
+    jobInfo.width = jobImage.width();
+    jobInfo.height = jobImage.height();
+    jobInfo.xTimes = static_cast<float>(outputSize.width()) / jobInfo.width;
+    jobInfo.yTimes = static_cast<float>(outputSize.height()) / jobInfo.height;
 
     ui->TBDLabel->setText("Processing Image....");
     QCoreApplication::processEvents();
 
+    // Convert at whichever resolution is cheaper
     QString startTime = QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss");
-    QByteArray labDataBuf = convertRGBtoLAB(image, jobInfo);
+    StagePlan stagePlan = planStageOrder(jobInfo);
+    logEvent(selectedJobFullPath, stagePlan.summary, startTime, startTime);
+
+    QImage sourceImage = jobImage;
+    if (stagePlan.order == ResizeThenConvert) {
+        startTime = QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss");
+        sourceImage = resizeRGBImage(jobImage, jobInfo);
+        logEvent(selectedJobFullPath, "resizeRGBImage", startTime, QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss"));
+    }
+
+    startTime = QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss");
+    QByteArray labDataBuf = convertRGBtoLAB(sourceImage, jobInfo);
     QString finishTime = QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss");
     QString combinedString = "Dither = " + QString::number(jobInfo.dithering) +
                              ", nLevel = " + QString::number(jobInfo.nLevel) +
@@ -297,19 +327,17 @@ bool MainWindow::sendJobProcess(QImage& image, QString& guid)
     finishTime = QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss");
     logEvent(selectedJobFullPath, "ConvertLABtoCMYK", startTime, finishTime);
 
+    // The dither stage pulls the resized rows as it goes, so the image is never
+    // stored at printer resolution
     startTime = QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss");
-    QByteArray resizedCmykDataBuf = resizeCMYKData(cmykDataBuf, jobInfo);
-    finishTime = QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss");
-    logEvent(selectedJobFullPath, "resizeCMYKData", startTime, finishTime);
-
-    startTime = QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss");
+    RowResampler resampler = createCMYKResampler(cmykDataBuf, jobInfo);
     QByteArray outDataBuf;
     if (jobInfo.dithering <= 2)
-        outDataBuf = floydSteinbergDitherFloat(resizedCmykDataBuf, jobInfo);
+        outDataBuf = errorDiffusionDither(resampler, jobInfo);
     else
-        outDataBuf = orderedDither(resizedCmykDataBuf, jobInfo);
+        outDataBuf = orderedDither(resampler, jobInfo);
     finishTime = QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss");
-    logEvent(selectedJobFullPath, "Dithering", startTime, finishTime);
+    logEvent(selectedJobFullPath, "resizeCMYKData + Dithering", startTime, finishTime);
 
     ui->TBDLabel->setText("Saving native file....!");
 
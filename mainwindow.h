@@ -28,7 +28,8 @@ private:
     QString m_curfilePath;
     Ui::MainWindow *ui;
     QString lastUsedDirectory; // Store the last used directory
-    QImage m_curImage;
+    QImage m_curImage;      // Preview-sized decode of the selected image
+    QSize m_curImageSize;   // Full pixel size of the selected image
     QString m_guid;
     QString selectedJobFullPath; // Store the selected job's FullPath
     void loadJobList(); // Load the job list from a file
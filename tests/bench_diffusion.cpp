@@ -0,0 +1,73 @@
+#include <QtTest>
+#include "RIPConvert.h"
+#include "ErrorDiffusion.h"
+#include "testjobs.h"
+#include <random>
+
+// Error diffusion throughput: float against fixed-point kernels, and the
+// variable kernels against plain Floyd-Steinberg. Run the executable directly
+// (not part of ctest); QtTest reports the time of each row, e.g.
+// bench_diffusion -median 5.
+class BenchDiffusion : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void diffusion_data();
+    void diffusion();
+
+private:
+    QByteArray m_image;
+};
+
+// A printer-resolution band: 6000 x 1500 pixels of noise, so every pixel
+// carries an error and no branch is predictable
+static const int kWidth = 6000;
+static const int kHeight = 1500;
+
+void BenchDiffusion::initTestCase()
+{
+    m_image = QByteArray(kWidth * kHeight * 4, Qt::Uninitialized);
+    std::mt19937 random(49);
+    for (int i = 0; i < m_image.size(); ++i) {
+        m_image.data()[i] = static_cast<char>(random());
+    }
+}
+
+void BenchDiffusion::diffusion_data()
+{
+    QTest::addColumn<int>("levels");
+    QTest::addColumn<int>("kernel");
+    QTest::addColumn<bool>("fixedPoint");
+
+    const int kernels[] = {DiffusionFloydSteinberg, DiffusionJarvisJudiceNinke, DiffusionVariable, DiffusionVariableModulated};
+    const char* names[] = {"Floyd-Steinberg", "JJN", "variable", "variable modulated"};
+    for (int levels : {2, 4}) {
+        for (bool fixedPoint : {false, true}) {
+            const QString arithmetic = fixedPoint ? "fixed point" : "float";
+            for (int k = 0; k < 4; ++k) {
+                QTest::newRow(qPrintable(QString("%1, %2 levels, %3").arg(names[k]).arg(levels).arg(arithmetic)))
+                    << levels << kernels[k] << fixedPoint;
+            }
+        }
+    }
+}
+
+void BenchDiffusion::diffusion()
+{
+    QFETCH(int, levels);
+    QFETCH(int, kernel);
+    QFETCH(bool, fixedPoint);
+
+    QBENCHMARK {
+        TagJobInfoRecord jobInfo = testJob(kWidth, kHeight, levels);
+        jobInfo.diffusionKernel = kernel;
+        jobInfo.fixedPointDiffusion = fixedPoint;
+        const QByteArray prn = errorDiffusionDither(m_image, jobInfo);
+        QVERIFY(!prn.isEmpty());
+    }
+}
+
+QTEST_GUILESS_MAIN(BenchDiffusion)
+#include "bench_diffusion.moc"
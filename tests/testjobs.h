@@ -0,0 +1,73 @@
+#ifndef TESTJOBS_H
+#define TESTJOBS_H
+
+#include <QByteArray>
+#include <cstring>
+#include "ProcessStruct.h"
+
+// Dither job of a 'width' x 'height' CMYK image with C, M, Y and K planes of
+// 'levels' evenly spaced codes and identity ink tables. Everything else is
+// zero: Floyd-Steinberg, left-to-right rows, no strips, float errors.
+inline TagJobInfoRecord testJob(int width, int height, int levels)
+{
+    TagJobInfoRecord jobInfo{};
+    jobInfo.width = width;
+    jobInfo.height = height;
+    jobInfo.level = levels;
+    jobInfo.nLevel = levels;
+    for (int c = 0; c < 4; ++c) {
+        InkPlane plane;
+        plane.name = QString("CMYK").mid(c, 1);
+        plane.source = c;
+        for (int v = 0; v < 256; ++v) {
+            plane.lut[v] = static_cast<uchar>(v);
+        }
+        BuildLevelTable(plane, levels, QString());
+        jobInfo.inkPlanes.append(plane);
+    }
+    jobInfo.nColors = jobInfo.inkPlanes.size();
+    return jobInfo;
+}
+
+// Output codes of a .prn file as returned by the dither stages
+class PrnReader
+{
+public:
+    explicit PrnReader(const QByteArray& prn)
+        : m_prn(prn)
+    {
+        if (m_prn.size() >= static_cast<int>(sizeof(tagHeadRecord_1))) {
+            memcpy(&m_header, m_prn.constData(), sizeof(m_header));
+        } else {
+            memset(&m_header, 0, sizeof(m_header));
+        }
+    }
+
+    int width() const { return m_header.nWidth; }
+    int height() const { return m_header.nHeight; }
+
+    // The header agrees with the data size
+    bool isValid() const
+    {
+        return m_header.nColors > 0 && m_prn.size() == static_cast<int>(sizeof(tagHeadRecord_1))
+            + m_header.nBytesPerLine * m_header.nHeight * m_header.nColors;
+    }
+
+    // Code of 'plane' (0=C, 1=M, 2=Y, 3=K, 4.. light inks) at (x, y); the
+    // file stores K, C, M, Y, light inks
+    int level(int plane, int x, int y) const
+    {
+        const int slot = plane < 4 ? (plane + 1) % 4 : plane;
+        const uchar* line = reinterpret_cast<const uchar*>(m_prn.constData()) + sizeof(tagHeadRecord_1)
+            + (y * m_header.nColors + slot) * m_header.nBytesPerLine;
+        const int bit = x * m_header.nBits;
+        const int word = line[bit / 8] | (bit / 8 + 1 < m_header.nBytesPerLine ? line[bit / 8 + 1] << 8 : 0);
+        return word >> (bit % 8) & ((1 << m_header.nBits) - 1);
+    }
+
+private:
+    QByteArray m_prn;
+    tagHeadRecord_1 m_header;
+};
+
+#endif // TESTJOBS_H
@@ -0,0 +1,102 @@
+#include <QtTest>
+#include "BitPacking.h"
+#include <random>
+#include <vector>
+
+// PackLevels packs 32 pixels at a time with SIMD (packBits, packQuads,
+// packTriples) and the rest through a scalar bit accumulator. Both must give
+// the LSB-first bit stream the heads expect.
+class TestBitPacking : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void bitOrder();
+    void matchesReference();
+    void bitsPerPixel();
+};
+
+// Bit-by-bit packing: bit b of pixel i is bit i * bitsPerPixel + b of the
+// line, counting from bit 0 (the LSB) of byte 0
+static std::vector<uchar> referencePack(const std::vector<uchar>& levels, int bitsPerPixel)
+{
+    std::vector<uchar> packed((levels.size() * bitsPerPixel + 7) / 8, 0);
+    for (size_t i = 0; i < levels.size(); ++i) {
+        for (int b = 0; b < bitsPerPixel; ++b) {
+            if (levels[i] >> b & 1) {
+                const size_t bit = i * bitsPerPixel + b;
+                packed[bit / 8] |= static_cast<uchar>(1 << (bit % 8));
+            }
+        }
+    }
+    return packed;
+}
+
+static std::vector<uchar> pack(const std::vector<uchar>& levels, int bitsPerPixel)
+{
+    std::vector<uchar> packed((levels.size() * bitsPerPixel + 7) / 8, 0xEE);
+    PackLevels(levels.data(), static_cast<int>(levels.size()), bitsPerPixel, packed.data());
+    return packed;
+}
+
+void TestBitPacking::bitOrder()
+{
+    // 1 bit: pixel 0 is the LSB of byte 0, pixel 7 its MSB
+    QCOMPARE(pack({1, 0, 0, 0, 0, 0, 0, 0}, 1), std::vector<uchar>({0x01}));
+    QCOMPARE(pack({0, 0, 0, 0, 0, 0, 0, 1}, 1), std::vector<uchar>({0x80}));
+    QCOMPARE(pack({0, 0, 0, 0, 0, 0, 0, 0, 1}, 1), std::vector<uchar>({0x00, 0x01}));
+
+    // 2 bits: pixel 0 in bits 0-1, pixel 3 in bits 6-7
+    QCOMPARE(pack({3, 0, 0, 0}, 2), std::vector<uchar>({0x03}));
+    QCOMPARE(pack({0, 0, 0, 2}, 2), std::vector<uchar>({0x80}));
+    QCOMPARE(pack({1, 2, 3, 0, 1}, 2), std::vector<uchar>({0x39, 0x01}));
+
+    // 3 bits: 8 pixels in 3 bytes; pixel 2 (bits 6-8) crosses into byte 1
+    QCOMPARE(pack({7, 0, 0, 0, 0, 0, 0, 0}, 3), std::vector<uchar>({0x07, 0x00, 0x00}));
+    QCOMPARE(pack({0, 0, 5, 0, 0, 0, 0, 0}, 3), std::vector<uchar>({0x40, 0x01, 0x00}));
+    QCOMPARE(pack({0, 0, 0, 0, 0, 0, 0, 6}, 3), std::vector<uchar>({0x00, 0x00, 0xC0}));
+}
+
+void TestBitPacking::matchesReference()
+{
+    // Every count up to a few SIMD blocks, so each tail length is covered
+    // after zero, one and several blocks, plus long lines
+    std::vector<int> counts;
+    for (int count = 0; count <= 100; ++count) {
+        counts.push_back(count);
+    }
+    for (int count : {255, 256, 257, 1000, 1023, 4099}) {
+        counts.push_back(count);
+    }
+
+    std::mt19937 random(44);
+    for (int bitsPerPixel = 1; bitsPerPixel <= 3; ++bitsPerPixel) {
+        for (int count : counts) {
+            std::vector<uchar> levels(count);
+            for (uchar& level : levels) {
+                level = static_cast<uchar>(random() & ((1 << bitsPerPixel) - 1));
+            }
+
+            // A guard byte after the line must stay untouched
+            const int bytes = (count * bitsPerPixel + 7) / 8;
+            std::vector<uchar> packed(bytes + 1, 0xEE);
+            PackLevels(levels.data(), count, bitsPerPixel, packed.data());
+            QVERIFY2(packed[bytes] == 0xEE, qPrintable(QString("%1 bits, %2 pixels: wrote past the line").arg(bitsPerPixel).arg(count)));
+            packed.pop_back();
+            QVERIFY2(packed == referencePack(levels, bitsPerPixel),
+                     qPrintable(QString("%1 bits, %2 pixels").arg(bitsPerPixel).arg(count)));
+        }
+    }
+}
+
+void TestBitPacking::bitsPerPixel()
+{
+    QCOMPARE(BitsPerPixel(2), 1);
+    QCOMPARE(BitsPerPixel(3), 2);
+    QCOMPARE(BitsPerPixel(4), 2);
+    QCOMPARE(BitsPerPixel(5), 3);
+    QCOMPARE(BitsPerPixel(8), 3);
+}
+
+QTEST_GUILESS_MAIN(TestBitPacking)
+#include "tst_bitpacking.moc"
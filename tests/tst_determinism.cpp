@@ -0,0 +1,162 @@
+#include <QtTest>
+#include <QCryptographicHash>
+#include <QThread>
+#include <QThreadPool>
+#include "RIPConvert.h"
+#include "testjobs.h"
+#include <random>
+
+// The determinism contract of RIPConvert.h: the .prn file of a job depends on
+// its image and settings only, never on the core count or the scheduling.
+// Every dither stage is run on a fixed image with 1, 2, 7 and the ideal number
+// of pool threads, and the files must hash the same.
+class TestDeterminism : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void errorDiffusion_data();
+    void errorDiffusion();
+    void orderedDither_data();
+    void orderedDither();
+};
+
+// Wider than two diffusion strips and taller than several dither chunks
+static const int kWidth = 2300;
+static const int kHeight = 160;
+
+// Restores the global pool's thread count when a test returns
+struct ThreadCountGuard {
+    const int saved = QThreadPool::globalInstance()->maxThreadCount();
+    ~ThreadCountGuard() { QThreadPool::globalInstance()->setMaxThreadCount(saved); }
+};
+
+// Gradients in C and M, noise in Y, a flat tint in K
+static QByteArray testImage()
+{
+    QByteArray image(kWidth * kHeight * 4, Qt::Uninitialized);
+    uchar* pixels = reinterpret_cast<uchar*>(image.data());
+    std::mt19937 random(48);
+    for (int y = 0; y < kHeight; ++y) {
+        for (int x = 0; x < kWidth; ++x) {
+            uchar* pixel = pixels + (y * kWidth + x) * 4;
+            pixel[0] = static_cast<uchar>(x * 255 / (kWidth - 1));
+            pixel[1] = static_cast<uchar>(y * 255 / (kHeight - 1));
+            pixel[2] = static_cast<uchar>(random() & 0xFF);
+            pixel[3] = 40;
+        }
+    }
+    return image;
+}
+
+// C, M, Y, K and a light cyan plane, so the diffusion runs two lane groups
+static TagJobInfoRecord testJobWithLightInk(int levels, double scale)
+{
+    TagJobInfoRecord jobInfo = testJob(kWidth, kHeight, levels);
+    InkPlane light = jobInfo.inkPlanes[0];
+    light.name = "Lc";
+    BuildSplitCurve(light.lut, 0, 96, 40);
+    BuildLevelTable(light, levels, QString());
+    jobInfo.inkPlanes.append(light);
+    jobInfo.nColors = jobInfo.inkPlanes.size();
+    jobInfo.xTimes = static_cast<float>(scale);
+    jobInfo.yTimes = static_cast<float>(scale);
+    jobInfo.xResolution = 720.0f;
+    jobInfo.screenLpi = 85.0f;
+    return jobInfo;
+}
+
+// Hash of the .prn file 'dither' makes with each thread count; all must equal
+// the single-threaded one
+template <typename Dither>
+static void checkThreadCounts(Dither dither)
+{
+    ThreadCountGuard guard;
+    QByteArray expected;
+    for (int threads : {1, 2, 7, QThread::idealThreadCount()}) {
+        QThreadPool::globalInstance()->setMaxThreadCount(threads);
+        const QByteArray prn = dither();
+        QVERIFY(PrnReader(prn).isValid());
+        const QByteArray hash = QCryptographicHash::hash(prn, QCryptographicHash::Sha256);
+        if (expected.isEmpty()) {
+            expected = hash;
+        }
+        QVERIFY2(hash == expected, qPrintable(QString("%1 threads: %2, 1 thread: %3")
+                                                  .arg(threads)
+                                                  .arg(QString::fromLatin1(hash.toHex()))
+                                                  .arg(QString::fromLatin1(expected.toHex()))));
+    }
+}
+
+void TestDeterminism::errorDiffusion_data()
+{
+    QTest::addColumn<int>("levels");
+    QTest::addColumn<int>("kernel");
+    QTest::addColumn<bool>("serpentine");
+    QTest::addColumn<bool>("strips");
+    QTest::addColumn<bool>("fixedPoint");
+    QTest::addColumn<double>("scale");
+
+    QTest::newRow("Floyd-Steinberg") << 2 << 0 << false << false << false << 1.0;
+    QTest::newRow("JJN, serpentine, 4 levels") << 4 << 1 << true << false << false << 1.0;
+    QTest::newRow("variable modulated") << 2 << 7 << false << false << false << 1.0;
+    QTest::newRow("fixed point") << 2 << 0 << false << false << true << 1.0;
+    QTest::newRow("fixed point, variable modulated, serpentine, 4 levels") << 4 << 7 << true << false << true << 1.0;
+    QTest::newRow("strips") << 2 << 0 << false << true << false << 1.0;
+    QTest::newRow("strips, fixed point, Sierra-3, serpentine, 4 levels") << 4 << 3 << true << true << true << 1.0;
+    QTest::newRow("resampled") << 2 << 0 << false << false << false << 1.5;
+}
+
+void TestDeterminism::errorDiffusion()
+{
+    QFETCH(int, levels);
+    QFETCH(int, kernel);
+    QFETCH(bool, serpentine);
+    QFETCH(bool, strips);
+    QFETCH(bool, fixedPoint);
+    QFETCH(double, scale);
+
+    const QByteArray image = testImage();
+    checkThreadCounts([&]() {
+        TagJobInfoRecord jobInfo = testJobWithLightInk(levels, scale);
+        jobInfo.diffusionKernel = kernel;
+        jobInfo.serpentine = serpentine;
+        jobInfo.stripDiffusion = strips;
+        jobInfo.fixedPointDiffusion = fixedPoint;
+        jobInfo.resampleFilter = 2;
+        RowResampler resampler = createCMYKResampler(image, jobInfo);
+        return errorDiffusionDither(resampler, jobInfo);
+    });
+}
+
+void TestDeterminism::orderedDither_data()
+{
+    QTest::addColumn<int>("levels");
+    QTest::addColumn<int>("method");
+    QTest::addColumn<double>("scale");
+
+    // Dithering / 3: 1 = Bayer, 2 = blue noise, 3 = AM
+    QTest::newRow("Bayer") << 2 << 1 << 1.0;
+    QTest::newRow("blue noise, 4 levels") << 4 << 2 << 1.0;
+    QTest::newRow("AM") << 2 << 3 << 1.0;
+    QTest::newRow("AM, resampled, 4 levels") << 4 << 3 << 1.5;
+}
+
+void TestDeterminism::orderedDither()
+{
+    QFETCH(int, levels);
+    QFETCH(int, method);
+    QFETCH(double, scale);
+
+    const QByteArray image = testImage();
+    checkThreadCounts([&]() {
+        TagJobInfoRecord jobInfo = testJobWithLightInk(levels, scale);
+        jobInfo.dithering = method * 3;
+        jobInfo.resampleFilter = 2;
+        RowResampler resampler = createCMYKResampler(image, jobInfo);
+        return ::orderedDither(resampler, jobInfo);
+    });
+}
+
+QTEST_GUILESS_MAIN(TestDeterminism)
+#include "tst_determinism.moc"
@@ -0,0 +1,230 @@
+#include <QtTest>
+#include "RIPConvert.h"
+#include "ErrorDiffusion.h"
+#include "testjobs.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// The fixed-point kernels (job setting FixedPointDiffusion) against a plain
+// scalar implementation of the integer arithmetic described in
+// ErrorDiffusion.h, and their tone reproduction against the float kernels.
+class TestFixedDiffusion : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void matchesReference_data();
+    void matchesReference();
+    void toneMatchesFloat_data();
+    void toneMatchesFloat();
+};
+
+// One tap of a kernel: the offset to the right (mirrored on reversed rows)
+// and down, and the weight numerator over the kernel's divisor
+struct Tap {
+    int dx;
+    int dy;
+    int weight;
+};
+
+struct ReferenceKernel {
+    int divisor;
+    std::vector<Tap> taps;      // The first tap takes what the others leave
+};
+
+static const ReferenceKernel kReferenceKernels[] = {
+    // Floyd-Steinberg
+    {16, {{1, 0, 7}, {-1, 1, 3}, {0, 1, 5}, {1, 1, 1}}},
+    // Jarvis-Judice-Ninke
+    {48, {{1, 0, 7}, {2, 0, 5}, {-2, 1, 3}, {-1, 1, 5}, {0, 1, 7}, {1, 1, 5}, {2, 1, 3},
+          {-2, 2, 1}, {-1, 2, 3}, {0, 2, 5}, {1, 2, 3}, {2, 2, 1}}},
+    // Stucki
+    {42, {{1, 0, 8}, {2, 0, 4}, {-2, 1, 2}, {-1, 1, 4}, {0, 1, 8}, {1, 1, 4}, {2, 1, 2},
+          {-2, 2, 1}, {-1, 2, 2}, {0, 2, 4}, {1, 2, 2}, {2, 2, 1}}},
+    // Sierra-3
+    {32, {{1, 0, 5}, {2, 0, 3}, {-2, 1, 2}, {-1, 1, 4}, {0, 1, 5}, {1, 1, 4}, {2, 1, 2},
+          {-1, 2, 2}, {0, 2, 3}, {1, 2, 2}}},
+    // Sierra-2
+    {16, {{1, 0, 4}, {2, 0, 3}, {-2, 1, 1}, {-1, 1, 2}, {0, 1, 3}, {1, 1, 2}, {2, 1, 1}}},
+    // Sierra-Lite
+    {4, {{1, 0, 2}, {-1, 1, 1}, {0, 1, 1}}},
+};
+
+// Output codes of one plane, diffused one pixel at a time: errors in 1/32 ink
+// level, a pixel takes the code whose drop is nearest (ties go up), its error
+// is saturated to 16 bits and each share is rounded from 1/4096 weights
+static std::vector<int> referenceDiffusion(const ReferenceKernel& kernel, const InkPlane& plane,
+                                           const uchar* image, int width, int height, bool serpentine)
+{
+    const int errorOne = 1 << kFixedErrorBits;
+    std::vector<qint32> drops(plane.levels);
+    for (int i = 0; i < plane.levels; ++i) {
+        drops[i] = static_cast<qint32>(std::lround(plane.drops[i] * errorOne));
+    }
+    std::vector<qint32> weights;
+    for (const Tap& tap : kernel.taps) {
+        weights.push_back(static_cast<qint32>(std::lround(static_cast<double>(tap.weight) * (1 << kFixedWeightBits) / kernel.divisor)));
+    }
+
+    // Error rows with two guard pixels on each side
+    const int stride = width + 4;
+    std::vector<qint32> errors((height + 2) * stride, 0);
+    std::vector<int> codes(width * height);
+    for (int y = 0; y < height; ++y) {
+        const bool reverse = serpentine && (y & 1);
+        for (int i = 0; i < width; ++i) {
+            const int x = reverse ? width - 1 - i : i;
+            const qint32 value = plane.lut[image[(y * width + x) * 4 + plane.source]] * errorOne + errors[y * stride + x + 2];
+            int code = 0;
+            while (code + 1 < plane.levels && 2 * value >= drops[code] + drops[code + 1]) {
+                ++code;
+            }
+            codes[y * width + x] = code;
+
+            const qint32 error = std::clamp(value - drops[code], -32768, 32767);
+            qint32 spread = 0;
+            for (size_t t = 1; t < kernel.taps.size(); ++t) {
+                const Tap& tap = kernel.taps[t];
+                const qint32 share = (error * weights[t] + (1 << (kFixedWeightBits - 1))) >> kFixedWeightBits;
+                errors[(y + tap.dy) * stride + x + (reverse ? -tap.dx : tap.dx) + 2] += share;
+                spread += share;
+            }
+            const Tap& first = kernel.taps[0];
+            errors[(y + first.dy) * stride + x + (reverse ? -first.dx : first.dx) + 2] += error - spread;
+        }
+    }
+    return codes;
+}
+
+// Six planes, so the second lane group is partly empty: C, M, Y, K and two
+// inverted planes. With 4 levels every other plane has uneven drops.
+static TagJobInfoRecord sixPlaneJob(int width, int height, int levels)
+{
+    TagJobInfoRecord jobInfo = testJob(width, height, levels);
+    for (int c = 0; c < 2; ++c) {
+        InkPlane plane = jobInfo.inkPlanes[c];
+        for (int v = 0; v < 256; ++v) {
+            plane.lut[v] = static_cast<uchar>(255 - v);
+        }
+        jobInfo.inkPlanes.append(plane);
+    }
+    if (levels == 4) {
+        for (int c = 1; c < jobInfo.inkPlanes.size(); c += 2) {
+            BuildLevelTable(jobInfo.inkPlanes[c], levels, "0,40,130,255");
+        }
+    }
+    jobInfo.nColors = jobInfo.inkPlanes.size();
+    return jobInfo;
+}
+
+void TestFixedDiffusion::matchesReference_data()
+{
+    QTest::addColumn<int>("kernel");
+    QTest::addColumn<bool>("serpentine");
+
+    const char* names[] = {"Floyd-Steinberg", "JJN", "Stucki", "Sierra-3", "Sierra-2", "Sierra-Lite"};
+    for (int kernel = 0; kernel < 6; ++kernel) {
+        QTest::newRow(names[kernel]) << kernel << false;
+        QTest::newRow(qPrintable(QString("%1, serpentine").arg(names[kernel]))) << kernel << true;
+    }
+}
+
+void TestFixedDiffusion::matchesReference()
+{
+    QFETCH(int, kernel);
+    QFETCH(bool, serpentine);
+
+    // Random images: every pixel carries a large error, which saturates where
+    // inverted planes pile up. Sizes below, at and above the SIMD and
+    // wavefront blocks.
+    const int sizes[][2] = {{1, 1}, {2, 9}, {5, 200}, {37, 23}, {130, 3}, {300, 41}, {1000, 70}};
+    std::mt19937 random(49);
+    for (const auto& size : sizes) {
+        const int width = size[0];
+        const int height = size[1];
+        QByteArray image(width * height * 4, Qt::Uninitialized);
+        for (int i = 0; i < image.size(); ++i) {
+            image.data()[i] = static_cast<char>(random());
+        }
+
+        for (int levels = 2; levels <= 4; ++levels) {
+            TagJobInfoRecord jobInfo = sixPlaneJob(width, height, levels);
+            jobInfo.diffusionKernel = kernel;
+            jobInfo.serpentine = serpentine;
+            jobInfo.fixedPointDiffusion = true;
+            const PrnReader prn(errorDiffusionDither(image, jobInfo));
+            QVERIFY(prn.isValid());
+
+            for (int c = 0; c < jobInfo.inkPlanes.size(); ++c) {
+                const std::vector<int> expected = referenceDiffusion(kReferenceKernels[kernel], jobInfo.inkPlanes[c],
+                                                                     reinterpret_cast<const uchar*>(image.constData()),
+                                                                     width, height, serpentine);
+                for (int y = 0; y < height; ++y) {
+                    for (int x = 0; x < width; ++x) {
+                        if (prn.level(c, x, y) != expected[y * width + x]) {
+                            QFAIL(qPrintable(QString("%1 x %2, %3 levels, plane %4: code %5 at (%6, %7), expected %8")
+                                                 .arg(width).arg(height).arg(levels).arg(c)
+                                                 .arg(prn.level(c, x, y)).arg(x).arg(y).arg(expected[y * width + x])));
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Largest difference between the mean ink of the fixed-point and float
+// kernels on a flat tint, on the 0-255 ink scale, as documented in
+// ErrorDiffusion.h. The kernels below stay within 0.05.
+static const double kFixedToneTolerance = 0.1;
+
+// Mean ink of plane 0 of a flat 'tone' image, on the 0-255 scale
+static double flatToneInk(int tone, int levels, int kernel, bool fixedPoint)
+{
+    const int size = 256;
+    const QByteArray image(size * size * 4, static_cast<char>(tone));
+    TagJobInfoRecord jobInfo = testJob(size, size, levels);
+    jobInfo.diffusionKernel = kernel;
+    jobInfo.fixedPointDiffusion = fixedPoint;
+    const PrnReader prn(errorDiffusionDither(image, jobInfo));
+    double ink = 0.0;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            ink += jobInfo.inkPlanes[0].drops[prn.level(0, x, y)];
+        }
+    }
+    return ink / (size * size);
+}
+
+void TestFixedDiffusion::toneMatchesFloat_data()
+{
+    QTest::addColumn<int>("levels");
+    QTest::addColumn<int>("kernel");
+
+    QTest::newRow("Floyd-Steinberg") << 2 << 0;
+    QTest::newRow("Floyd-Steinberg, 4 levels") << 4 << 0;
+    QTest::newRow("JJN") << 2 << 1;
+    QTest::newRow("Sierra-Lite, 3 levels") << 3 << 5;
+}
+
+void TestFixedDiffusion::toneMatchesFloat()
+{
+    QFETCH(int, levels);
+    QFETCH(int, kernel);
+
+    // Flat tints across the tone scale: the fixed-point mean ink must stay
+    // within kFixedToneTolerance of the float kernel's. Both lose some ink
+    // with the errors pushed off the right and bottom edges; the fixed-point
+    // drops and weights are rounded, so their losses differ slightly.
+    for (int tone = 0; tone < 256; tone += 5) {
+        const double fixedInk = flatToneInk(tone, levels, kernel, true);
+        const double floatInk = flatToneInk(tone, levels, kernel, false);
+        QVERIFY2(std::abs(fixedInk - floatInk) <= kFixedToneTolerance,
+                 qPrintable(QString("tone %1: mean ink %2, float kernel %3").arg(tone).arg(fixedInk).arg(floatInk)));
+    }
+}
+
+QTEST_GUILESS_MAIN(TestFixedDiffusion)
+#include "tst_fixeddiffusion.moc"
@@ -0,0 +1,110 @@
+#include <QtTest>
+#include "RIPConvert.h"
+#include "testjobs.h"
+#include <cmath>
+
+// Level tables of a job that gives drop densities for some of its planes
+// only: the other planes must use every code of the wider pixel, not just
+// the codes they would have had without the densities.
+class TestInkPlanes : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void levelTables_data();
+    void levelTables();
+    void plainPlanesInk();
+};
+
+// Five drops for cyan, none for M, Y and K
+static const char* const kCyanDrops = "0,40,90,150,255";
+
+void TestInkPlanes::levelTables_data()
+{
+    QTest::addColumn<int>("nLevel");
+    QTest::addColumn<QString>("cyanDrops");
+    QTest::addColumn<int>("levels");
+
+    QTest::newRow("bilevel job, 5 drops") << 2 << QString(kCyanDrops) << 5;
+    QTest::newRow("4-level job, 5 drops") << 4 << QString(kCyanDrops) << 5;
+    QTest::newRow("8-level job, 5 drops") << 8 << QString(kCyanDrops) << 8;
+    QTest::newRow("invalid drops") << 2 << QString("0,40,30,255") << 2;
+    QTest::newRow("no drops") << 3 << QString() << 3;
+}
+
+void TestInkPlanes::levelTables()
+{
+    QFETCH(int, nLevel);
+    QFETCH(QString, cyanDrops);
+    QFETCH(int, levels);
+
+    TagJobInfoRecord jobInfo = testJob(64, 64, nLevel);
+    QStringList drops;
+    drops << cyanDrops << QString() << QString() << QString();
+    QCOMPARE(BuildLevelTables(jobInfo.inkPlanes, nLevel, drops), levels);
+    QCOMPARE(OutputLevels(jobInfo.inkPlanes), levels);
+
+    // Planes without densities: evenly spaced codes over the whole job level
+    // count, nearest codes and tones to match
+    for (int c = 1; c < 4; ++c) {
+        const InkPlane& plane = jobInfo.inkPlanes[c];
+        QCOMPARE(plane.levels, levels);
+        const float step = 255.0f / (levels - 1);
+        for (int i = 0; i < levels; ++i) {
+            QCOMPARE(plane.drops[i], i * step);
+        }
+        QCOMPARE(static_cast<int>(plane.nearest[0]), 0);
+        QCOMPARE(static_cast<int>(plane.nearest[255]), levels - 1);
+    }
+}
+
+void TestInkPlanes::plainPlanesInk()
+{
+    // A bilevel job whose cyan has five drops: the job prints 3-bit pixels,
+    // so M, Y and K must dither between the two of their five codes around
+    // each tint and print the tint's ink on average
+    const int size = 256;
+    const int tints[4] = {100, 30, 100, 200};
+    QByteArray image(size * size * 4, Qt::Uninitialized);
+    uchar* pixels = reinterpret_cast<uchar*>(image.data());
+    for (int i = 0; i < size * size; ++i) {
+        for (int c = 0; c < 4; ++c) {
+            pixels[i * 4 + c] = static_cast<uchar>(tints[c]);
+        }
+    }
+
+    TagJobInfoRecord jobInfo = testJob(size, size, 2);
+    QStringList drops;
+    drops << kCyanDrops << QString() << QString() << QString();
+    jobInfo.nLevel = BuildLevelTables(jobInfo.inkPlanes, jobInfo.nLevel, drops);
+    jobInfo.level = jobInfo.nLevel;
+    const PrnReader prn(errorDiffusionDither(image, jobInfo));
+    QVERIFY(prn.isValid());
+
+    // A plain plane's code prints as that code of an evenly spaced head, on
+    // the job's level count
+    const float step = 255.0f / (jobInfo.nLevel - 1);
+    QCOMPARE(jobInfo.nLevel, 5);
+    for (int c = 1; c < 4; ++c) {
+        const int low = static_cast<int>(tints[c] / step);
+        double ink = 0.0;
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                const int code = prn.level(c, x, y);
+                if (code != low && code != low + 1) {
+                    QFAIL(qPrintable(QString("plane %1, tint %2: code %3 at (%4, %5), expected %6 or %7")
+                                         .arg(c).arg(tints[c]).arg(code).arg(x).arg(y).arg(low).arg(low + 1)));
+                }
+                ink += code * step;
+            }
+        }
+        // The error pushed off the right and bottom edges: under a drop
+        // step in a row or column of the image
+        ink /= size * size;
+        QVERIFY2(std::abs(ink - tints[c]) < step / size,
+                 qPrintable(QString("plane %1, tint %2: mean ink %3").arg(c).arg(tints[c]).arg(ink)));
+    }
+}
+
+QTEST_GUILESS_MAIN(TestInkPlanes)
+#include "tst_inkplanes.moc"
@@ -0,0 +1,197 @@
+#include <QtTest>
+#include "RIPConvert.h"
+#include "testjobs.h"
+#include <cmath>
+
+// Strip diffusion cuts rows into 1024-pixel strips that are diffused on their
+// own, each with an apron on both sides so its edge error state matches its
+// neighbours'. A seam shows as a band of lighter or darker dots along a strip
+// boundary. These tests diffuse images three strips wide and compare the ink
+// printed in a band across each boundary with the ink printed away from it,
+// or for ramps with the same band diffused in whole rows.
+class TestStripSeams : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void flatTints_data();
+    void flatTints();
+    void ramps_data();
+    void ramps();
+};
+
+// Width of the test images: two boundaries, at 1024 and 2048
+static const int kWidth = 3000;
+static const int kHeight = 256;
+static const int kBoundaries[] = {1024, 2048};
+
+// Columns on each side of a boundary that make up its band, and the distance
+// from boundaries and image edges of the columns that count as away from them
+static const int kSeamHalfWidth = 16;
+static const int kAwayDistance = 128;
+
+// Largest difference allowed between the mean ink of a band and its
+// reference, on the 0-255 ink scale: one drop more or less in every 256 pixels
+// (8 rows) of the band. With their aprons the strips stay within 3/4 of this
+// on these images; strips diffused without aprons are off by 1.1 to 3 times it.
+static double seamTolerance(int levels)
+{
+    return 255.0 / (levels - 1) / 256.0;
+}
+
+// Mean ink of 'plane' over the columns 'x0' .. 'x1' - 1 of every row, on the
+// 0-255 scale
+static double meanInk(const PrnReader& prn, int plane, int levels, int x0, int x1)
+{
+    double sum = 0.0;
+    for (int y = 0; y < prn.height(); ++y) {
+        for (int x = x0; x < x1; ++x) {
+            sum += prn.level(plane, x, y);
+        }
+    }
+    return sum * 255.0 / (levels - 1) / (static_cast<double>(x1 - x0) * prn.height());
+}
+
+static bool nearBoundary(int x, int distance)
+{
+    if (x < distance || x >= kWidth - distance) {
+        return true;
+    }
+    for (int boundary : kBoundaries) {
+        if (std::abs(x - boundary) < distance) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Diffuse 'image' with the given kernel and settings, in strips or in whole rows
+static QByteArray diffuse(const QByteArray& image, int levels, int kernel, bool serpentine, bool strips)
+{
+    TagJobInfoRecord jobInfo = testJob(kWidth, kHeight, levels);
+    jobInfo.diffusionKernel = kernel;
+    jobInfo.serpentine = serpentine;
+    jobInfo.stripDiffusion = strips;
+    return errorDiffusionDither(image, jobInfo);
+}
+
+static void addKernelRows()
+{
+    QTest::addColumn<int>("levels");
+    QTest::addColumn<int>("kernel");
+    QTest::addColumn<bool>("serpentine");
+
+    for (int levels : {2, 4}) {
+        // Floyd-Steinberg, Jarvis-Judice-Ninke (widest reach), variable
+        for (int kernel : {0, 1, 6}) {
+            for (bool serpentine : {false, true}) {
+                QTest::newRow(qPrintable(QString("%1 levels, kernel %2%3").arg(levels).arg(kernel).arg(serpentine ? ", serpentine" : "")))
+                    << levels << kernel << serpentine;
+            }
+        }
+    }
+}
+
+void TestStripSeams::flatTints_data()
+{
+    addKernelRows();
+}
+
+void TestStripSeams::flatTints()
+{
+    QFETCH(int, levels);
+    QFETCH(int, kernel);
+    QFETCH(bool, serpentine);
+
+    // Eight tints, four planes at a time: highlights, where seams show most,
+    // midtones and shadows
+    const int tints[2][4] = {{6, 20, 64, 128}, {160, 200, 240, 250}};
+    for (const auto& tint : tints) {
+        QByteArray image(kWidth * kHeight * 4, Qt::Uninitialized);
+        uchar* pixels = reinterpret_cast<uchar*>(image.data());
+        for (int i = 0; i < kWidth * kHeight; ++i) {
+            for (int c = 0; c < 4; ++c) {
+                pixels[i * 4 + c] = static_cast<uchar>(tint[c]);
+            }
+        }
+
+        const PrnReader prn(diffuse(image, levels, kernel, serpentine, true));
+        QVERIFY(prn.isValid());
+
+        for (int c = 0; c < 4; ++c) {
+            // Away from boundaries: whole runs of columns, so the ink is
+            // conserved along each row
+            double awaySum = 0.0;
+            int awayColumns = 0;
+            int x = 0;
+            while (x < kWidth) {
+                int end = x;
+                while (end < kWidth && !nearBoundary(end, kAwayDistance)) {
+                    ++end;
+                }
+                if (end > x) {
+                    awaySum += meanInk(prn, c, levels, x, end) * (end - x);
+                    awayColumns += end - x;
+                }
+                x = end + 1;
+            }
+            const double away = awaySum / awayColumns;
+            QVERIFY2(std::abs(away - tint[c]) < seamTolerance(levels),
+                     qPrintable(QString("tint %1: %2 away from the boundaries").arg(tint[c]).arg(away)));
+
+            for (int boundary : kBoundaries) {
+                const double seam = meanInk(prn, c, levels, boundary - kSeamHalfWidth, boundary + kSeamHalfWidth);
+                QVERIFY2(std::abs(seam - away) < seamTolerance(levels),
+                         qPrintable(QString("tint %1: %2 at the boundary at %3, %4 away from it")
+                                        .arg(tint[c]).arg(seam).arg(boundary).arg(away)));
+            }
+        }
+    }
+}
+
+void TestStripSeams::ramps_data()
+{
+    addKernelRows();
+}
+
+void TestStripSeams::ramps()
+{
+    QFETCH(int, levels);
+    QFETCH(int, kernel);
+    QFETCH(bool, serpentine);
+
+    // C and M ramp across the strips, Y and K down them. Diffusion lags
+    // behind a ramp, so each band is compared with the same columns diffused
+    // in whole rows.
+    QByteArray image(kWidth * kHeight * 4, Qt::Uninitialized);
+    uchar* pixels = reinterpret_cast<uchar*>(image.data());
+    for (int y = 0; y < kHeight; ++y) {
+        for (int x = 0; x < kWidth; ++x) {
+            uchar* pixel = pixels + (y * kWidth + x) * 4;
+            pixel[0] = static_cast<uchar>(x * 255 / (kWidth - 1));
+            pixel[1] = static_cast<uchar>(255 - x * 255 / (kWidth - 1));
+            pixel[2] = static_cast<uchar>(y * 255 / (kHeight - 1));
+            pixel[3] = static_cast<uchar>(16 + y * 64 / (kHeight - 1));
+        }
+    }
+
+    const PrnReader prn(diffuse(image, levels, kernel, serpentine, true));
+    const PrnReader rows(diffuse(image, levels, kernel, serpentine, false));
+    QVERIFY(prn.isValid());
+    QVERIFY(rows.isValid());
+
+    for (int c = 0; c < 4; ++c) {
+        for (int boundary : kBoundaries) {
+            const int x0 = boundary - kSeamHalfWidth;
+            const int x1 = boundary + kSeamHalfWidth;
+            const double seam = meanInk(prn, c, levels, x0, x1);
+            const double reference = meanInk(rows, c, levels, x0, x1);
+            QVERIFY2(std::abs(seam - reference) < seamTolerance(levels),
+                     qPrintable(QString("plane %1: %2 at the boundary at %3, %4 without strips")
+                                    .arg(c).arg(seam).arg(boundary).arg(reference)));
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(TestStripSeams)
+#include "tst_stripseams.moc"
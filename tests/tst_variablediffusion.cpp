@@ -0,0 +1,115 @@
+#include <QtTest>
+#include "ErrorDiffusion.h"
+#include <cmath>
+
+// The 256-entry coefficient table of the variable kernels (DiffusionVariable
+// and DiffusionVariableModulated) against its description in ErrorDiffusion.h
+class TestVariableDiffusion : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void weightsSumToOne();
+    void keyTones();
+    void interpolation();
+    void mirroredAroundMidGrey();
+    void fixedPointRows();
+};
+
+static const int kKeyCount = sizeof(kVariableDiffusionKeys) / sizeof(kVariableDiffusionKeys[0]);
+
+// Float rounding of the normalization and interpolation
+static const float kWeightTolerance = 1e-5f;
+
+void TestVariableDiffusion::weightsSumToOne()
+{
+    for (int tone = 0; tone < 256; ++tone) {
+        const float* weights = VariableDiffusionWeights(tone);
+        for (int i = 0; i < 3; ++i) {
+            QVERIFY2(weights[i] >= 0.0f, qPrintable(QString("tone %1, weight %2: %3").arg(tone).arg(i).arg(weights[i])));
+        }
+        const float sum = weights[0] + weights[1] + weights[2];
+        QVERIFY2(std::abs(sum - 1.0f) <= kWeightTolerance, qPrintable(QString("tone %1: weights sum to %2").arg(tone).arg(sum)));
+    }
+}
+
+void TestVariableDiffusion::keyTones()
+{
+    // The keys start at no ink, end at mid-grey and have weights summing to 1
+    QCOMPARE(kVariableDiffusionKeys[0].tone, 0);
+    QCOMPARE(kVariableDiffusionKeys[kKeyCount - 1].tone, 127);
+    for (int k = 0; k < kKeyCount; ++k) {
+        const VariableDiffusionKey& key = kVariableDiffusionKeys[k];
+        if (k > 0) {
+            QVERIFY(key.tone > kVariableDiffusionKeys[k - 1].tone);
+        }
+        QVERIFY(std::abs(key.right + key.downLeft + key.down - 1.0f) <= kWeightTolerance);
+
+        // The table holds the key's weights at its tone
+        const float* weights = VariableDiffusionWeights(key.tone);
+        QVERIFY2(std::abs(weights[0] - key.right) <= kWeightTolerance
+                     && std::abs(weights[1] - key.downLeft) <= kWeightTolerance
+                     && std::abs(weights[2] - key.down) <= kWeightTolerance
+                     && std::abs(weights[3] - key.modulation / 128.0f) <= kWeightTolerance,
+                 qPrintable(QString("key tone %1").arg(key.tone)));
+    }
+}
+
+void TestVariableDiffusion::interpolation()
+{
+    // Tones between two keys lie on the straight line between them
+    for (int k = 0; k + 1 < kKeyCount; ++k) {
+        const VariableDiffusionKey& low = kVariableDiffusionKeys[k];
+        const VariableDiffusionKey& high = kVariableDiffusionKeys[k + 1];
+        for (int tone = low.tone; tone <= high.tone; ++tone) {
+            const float f = static_cast<float>(tone - low.tone) / (high.tone - low.tone);
+            const float expected[4] = {
+                low.right + (high.right - low.right) * f,
+                low.downLeft + (high.downLeft - low.downLeft) * f,
+                low.down + (high.down - low.down) * f,
+                (low.modulation + (high.modulation - low.modulation) * f) / 128.0f
+            };
+            const float* weights = VariableDiffusionWeights(tone);
+            for (int i = 0; i < 4; ++i) {
+                QVERIFY2(std::abs(weights[i] - expected[i]) <= kWeightTolerance,
+                         qPrintable(QString("tone %1, entry %2: %3, expected %4").arg(tone).arg(i).arg(weights[i]).arg(expected[i])));
+            }
+        }
+    }
+}
+
+void TestVariableDiffusion::mirroredAroundMidGrey()
+{
+    for (int tone = 0; tone < 128; ++tone) {
+        const float* weights = VariableDiffusionWeights(tone);
+        const float* mirrored = VariableDiffusionWeights(255 - tone);
+        for (int i = 0; i < 4; ++i) {
+            QVERIFY2(weights[i] == mirrored[i], qPrintable(QString("tone %1, entry %2").arg(tone).arg(i)));
+        }
+    }
+
+    // The modulation is zero in the highlights and largest at mid-grey
+    QCOMPARE(VariableDiffusionWeights(0)[3], 0.0f);
+    QCOMPARE(VariableDiffusionWeights(11)[3], 0.0f);
+    for (int tone = 0; tone < 256; ++tone) {
+        QVERIFY(VariableDiffusionWeights(tone)[3] <= VariableDiffusionWeights(127)[3]);
+    }
+}
+
+void TestVariableDiffusion::fixedPointRows()
+{
+    // Weights in 1/4096 and modulation in 1/128 step, rounded from the float row
+    for (int tone = 0; tone < 256; ++tone) {
+        const float* weights = VariableDiffusionWeights(tone);
+        const qint32* fixedWeights = VariableDiffusionFixedWeights(tone);
+        for (int i = 0; i < 3; ++i) {
+            QCOMPARE(fixedWeights[i], static_cast<qint32>(std::lround(weights[i] * (1 << kFixedWeightBits))));
+        }
+        QCOMPARE(fixedWeights[3], static_cast<qint32>(std::lround(weights[3] * 128.0f)));
+        const qint32 sum = fixedWeights[0] + fixedWeights[1] + fixedWeights[2];
+        QVERIFY2(std::abs(sum - (1 << kFixedWeightBits)) <= 1, qPrintable(QString("tone %1: fixed weights sum to %2").arg(tone).arg(sum)));
+    }
+}
+
+QTEST_GUILESS_MAIN(TestVariableDiffusion)
+#include "tst_variablediffusion.moc"